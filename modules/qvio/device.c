@@ -14,6 +14,9 @@ struct qvio_device* qvio_device_new(void) {
 	}
 
 	kref_init(&self->ref);
+	mutex_init(&self->reg_mutex);
+	mutex_init(&self->engine_mutex);
+	qvio_group_init(&self->group);
 
 	return self;
 
@@ -136,6 +139,7 @@ void qvio_device_xdma_close(struct qvio_device* self) {
 void qvio_device_xdma_online(struct qvio_device* self, struct pci_dev *pdev) {
 #if 1 // USE_LIBXDMA
 	xdma_device_online(pdev, self->xdev);
+	qvio_regs_invalidate(&self->regs);
 #endif // USE_LIBXDMA
 }
 
@@ -144,3 +148,98 @@ void qvio_device_xdma_offline(struct qvio_device* self, struct pci_dev *pdev) {
 	xdma_device_offline(pdev, self->xdev);
 #endif // USE_LIBXDMA
 }
+
+#if 1 // USE_LIBXDMA
+static struct qvio_video* __engine_video(struct qvio_device* self, int channel) {
+	int i;
+
+	for(i = 0; i < QVIO_MAX_VIDEO; i++) {
+		if(self->video[i] && self->video[i]->channel == channel)
+			return self->video[i];
+	}
+
+	return NULL;
+}
+
+static int __engine_offline(struct qvio_device* self, int channel) {
+	int err;
+	struct qvio_video* video = __engine_video(self, channel);
+
+	// buffers queued from here on are held by the node
+	if(video)
+		qvio_queue_offline(&video->queue);
+
+	err = xdma_engine_offline(self->xdev, channel, false);
+	if(err) {
+		pr_err("xdma_engine_offline() failed, err=%d\n", err);
+		return err;
+	}
+
+	return 0;
+}
+
+static int __engine_online(struct qvio_device* self, int channel) {
+	int err;
+	struct qvio_video* video = __engine_video(self, channel);
+
+	err = xdma_engine_online(self->xdev, channel, false);
+	if(err) {
+		pr_err("xdma_engine_online() failed, err=%d\n", err);
+		return err;
+	}
+
+	if(video)
+		qvio_queue_online(&video->queue);
+
+	return 0;
+}
+#endif // USE_LIBXDMA
+
+int qvio_device_engine_offline(struct qvio_device* self, int channel) {
+	int err = -ENODEV;
+
+#if 1 // USE_LIBXDMA
+	mutex_lock(&self->engine_mutex);
+	err = __engine_offline(self, channel);
+	mutex_unlock(&self->engine_mutex);
+#endif // USE_LIBXDMA
+
+	return err;
+}
+
+int qvio_device_engine_online(struct qvio_device* self, int channel) {
+	int err = -ENODEV;
+
+#if 1 // USE_LIBXDMA
+	mutex_lock(&self->engine_mutex);
+	err = __engine_online(self, channel);
+	mutex_unlock(&self->engine_mutex);
+#endif // USE_LIBXDMA
+
+	return err;
+}
+
+int qvio_device_engine_reset(struct qvio_device* self, int channel) {
+	int err = -ENODEV;
+
+#if 1 // USE_LIBXDMA
+	mutex_lock(&self->engine_mutex);
+	err = __engine_offline(self, channel);
+	if(! err)
+		err = __engine_online(self, channel);
+	mutex_unlock(&self->engine_mutex);
+#endif // USE_LIBXDMA
+
+	return err;
+}
+
+void qvio_device_user_irq(struct qvio_device* self, int irq) {
+	int i;
+
+	for(i = 0; i < QVIO_MAX_VIDEO; i++) {
+		if(self->video[i]) {
+			qvio_queue_user_irq(&self->video[i]->queue, irq);
+			qvio_source_irq(&self->video[i]->source, irq);
+		}
+	}
+}
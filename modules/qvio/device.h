@@ -3,6 +3,10 @@
 
 #include "cdev.h"
 #include "video.h"
+#include "group.h"
+#include "i2c.h"
+#include "user_irq.h"
+#include "regs.h"
 #include "libxdma.h"
 
 #include <linux/platform_device.h>
@@ -31,7 +35,25 @@ struct qvio_device {
 	struct xdma_dev *xdev;
 #endif // USE_LIBXDMA
 
+	// shadow of the control registers, pci only
+	struct qvio_regs regs;
+
+	// serializes QVID_IOC_REG_OPS, RMW and POLL entries are not torn by other callers
+	struct mutex reg_mutex;
+
+	// serializes per-engine offline, online and reset
+	struct mutex engine_mutex;
+
+	// i2c adapter on the card's I2C FIFO controller, pci only
+	struct qvio_i2c i2c;
+
+	// user interrupts not taken by the i2c adapter, delivered on the cdev
+	struct qvio_user_irq user_irq;
+
 	struct qvio_video* video[QVIO_MAX_VIDEO];
+
+	// genlocked capture channels
+	struct qvio_group group;
 };
 
 struct qvio_device* qvio_device_new(void);
@@ -43,4 +65,12 @@ void qvio_device_xdma_close(struct qvio_device* self);
 void qvio_device_xdma_online(struct qvio_device* self, struct pci_dev *pdev);
 void qvio_device_xdma_offline(struct qvio_device* self, struct pci_dev *pdev);
 
+// one C2H engine and the video node on it, the other channels keep streaming
+int qvio_device_engine_offline(struct qvio_device* self, int channel);
+int qvio_device_engine_online(struct qvio_device* self, int channel);
+int qvio_device_engine_reset(struct qvio_device* self, int channel);
+
+// user IRQ of the card, passed on to the video nodes, any context
+void qvio_device_user_irq(struct qvio_device* self, int irq);
+
 #endif // __QVIO_DEVICE_H__
@@ -0,0 +1,209 @@
+#define pr_fmt(fmt)     "[" KBUILD_MODNAME "]%s(#%d): " fmt, __func__, __LINE__
+
+#include "group.h"
+
+#include <linux/kernel.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/math64.h>
+#include <linux/bug.h>
+
+void qvio_sof_reset(struct qvio_sof* self, u64 interval) {
+	self->valid = false;
+	self->sequence = 0;
+	self->time = 0;
+	self->interval = max_t(u64, interval, 1);
+}
+
+u32 qvio_sof_frame(struct qvio_sof* self, u64 time, bool advance) {
+	s64 delta, half;
+	s64 n;
+
+	// the first frame seen is frame 0
+	if(! self->valid) {
+		if(advance) {
+			self->valid = true;
+			self->time = time;
+		}
+
+		return 0;
+	}
+
+	// rounded to the closest start of frame
+	delta = (s64)(time - self->time);
+	half = (s64)(self->interval / 2);
+	n = div64_s64(delta + (delta >= 0 ? half : -half), (s64)self->interval);
+	if(n < 0 && (u64)-n > self->sequence)
+		n = -(s64)self->sequence;
+
+	if(advance && n > 0) {
+		self->sequence += (u32)n;
+		self->time = time;
+
+		return self->sequence;
+	}
+
+	return self->sequence + (u32)n;
+}
+
+u32 qvio_sof_irq(struct qvio_sof* self, u64 time) {
+	if(self->valid)
+		self->sequence++;
+	self->valid = true;
+	self->time = time;
+
+	return self->sequence;
+}
+
+#if 0 // TEST
+// A drops frame 1 and leads, B completes every frame a little later, both number by source frame
+static void __sof_test(void) {
+	struct qvio_sof sof;
+	u64 t = 1000000000ULL, T = 16666667ULL;
+
+	qvio_sof_reset(&sof, T);
+	WARN_ON(qvio_sof_frame(&sof, t + 0 * T + 100000, true) != 0); // A0
+	WARN_ON(qvio_sof_frame(&sof, t + 0 * T + 900000, true) != 0); // B0
+	WARN_ON(qvio_sof_frame(&sof, t + 1 * T + 800000, true) != 1); // B1
+	WARN_ON(qvio_sof_frame(&sof, t + 2 * T + 200000, true) != 2); // A2
+	WARN_ON(qvio_sof_frame(&sof, t + 2 * T + 700000, true) != 2); // B2
+	WARN_ON(qvio_sof_frame(&sof, t + 3 * T + 300000, true) != 3); // A3
+	WARN_ON(qvio_sof_frame(&sof, t + 3 * T + 600000, true) != 3); // B3
+}
+#endif
+
+void qvio_group_init(struct qvio_group* self) {
+	spin_lock_init(&self->lock);
+	self->members = 0;
+	self->armed = 0;
+	qvio_sof_reset(&self->sof, 0);
+	memset(self->ts, 0, sizeof(self->ts));
+
+#if 0 // TEST
+	__sof_test();
+#endif
+}
+
+int qvio_group_join(struct qvio_group* self, int channel) {
+	int err;
+	unsigned long flags;
+
+	if(channel < 0 || channel >= 32) {
+		pr_err("unexpected value, channel=%d\n", channel);
+		err = -EINVAL;
+		goto err0;
+	}
+
+	spin_lock_irqsave(&self->lock, flags);
+	if(self->armed) {
+		spin_unlock_irqrestore(&self->lock, flags);
+		pr_err("group is streaming, armed=0x%X\n", self->armed);
+		err = -EBUSY;
+		goto err0;
+	}
+	self->members |= BIT(channel);
+	spin_unlock_irqrestore(&self->lock, flags);
+
+	return 0;
+
+err0:
+	return err;
+}
+
+void qvio_group_leave(struct qvio_group* self, int channel) {
+	unsigned long flags;
+
+	if(channel < 0 || channel >= 32)
+		return;
+
+	spin_lock_irqsave(&self->lock, flags);
+	self->members &= ~BIT(channel);
+	self->armed &= ~BIT(channel);
+	spin_unlock_irqrestore(&self->lock, flags);
+}
+
+bool qvio_group_has(struct qvio_group* self, int channel) {
+	if(channel < 0 || channel >= 32)
+		return false;
+
+	return (READ_ONCE(self->members) & BIT(channel)) != 0;
+}
+
+bool qvio_group_armed(struct qvio_group* self, int channel) {
+	if(channel < 0 || channel >= 32)
+		return false;
+
+	return (READ_ONCE(self->armed) & BIT(channel)) != 0;
+}
+
+bool qvio_group_arm(struct qvio_group* self, int channel, u64 interval) {
+	bool ret;
+	unsigned long flags;
+
+	spin_lock_irqsave(&self->lock, flags);
+	self->armed |= BIT(channel);
+	ret = (self->armed == self->members);
+	if(ret) {
+		qvio_sof_reset(&self->sof, interval);
+		memset(self->ts, 0, sizeof(self->ts));
+	}
+	spin_unlock_irqrestore(&self->lock, flags);
+
+	return ret;
+}
+
+bool qvio_group_disarm(struct qvio_group* self, int channel) {
+	bool ret;
+	unsigned long flags;
+
+	spin_lock_irqsave(&self->lock, flags);
+	self->armed &= ~BIT(channel);
+	ret = (self->armed == 0);
+	spin_unlock_irqrestore(&self->lock, flags);
+
+	return ret;
+}
+
+u32 qvio_group_sequence(struct qvio_group* self, u64 time, bool advance) {
+	unsigned long flags;
+	u32 sequence;
+
+	spin_lock_irqsave(&self->lock, flags);
+	sequence = qvio_sof_frame(&self->sof, time, advance);
+	spin_unlock_irqrestore(&self->lock, flags);
+
+	return sequence;
+}
+
+bool qvio_group_sof_irq(struct qvio_group* self, u64 time, u32* sequence) {
+	bool ret;
+	unsigned long flags;
+
+	spin_lock_irqsave(&self->lock, flags);
+	ret = self->members && self->armed == self->members;
+	if(ret) {
+		// the members after the first see the same interrupt
+		if(self->sof.valid && time - self->sof.time < self->sof.interval / 2)
+			*sequence = self->sof.sequence;
+		else
+			*sequence = qvio_sof_irq(&self->sof, time);
+	}
+	spin_unlock_irqrestore(&self->lock, flags);
+
+	return ret;
+}
+
+u64 qvio_group_timestamp(struct qvio_group* self, u32 sequence, u64 timestamp) {
+	unsigned long flags;
+	int i = sequence % QVIO_GROUP_TS_RING;
+
+	spin_lock_irqsave(&self->lock, flags);
+	if(self->ts[i].timestamp == 0 || self->ts[i].sequence != sequence) {
+		self->ts[i].sequence = sequence;
+		self->ts[i].timestamp = timestamp;
+	}
+	timestamp = self->ts[i].timestamp;
+	spin_unlock_irqrestore(&self->lock, flags);
+
+	return timestamp;
+}
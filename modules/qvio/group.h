@@ -0,0 +1,62 @@
+#ifndef __QVIO_GROUP_H__
+#define __QVIO_GROUP_H__
+
+#include <linux/types.h>
+#include <linux/spinlock_types.h>
+#include <linux/atomic.h>
+
+#define QVIO_GROUP_TS_RING 16
+
+// source frame index since STREAMON, taken from the start time of a frame,
+// starts within half an interval of the latest known start of frame are the same frame
+struct qvio_sof {
+	bool valid;		// a start of frame has been seen since the reset
+	u32 sequence;	// the latest start of frame
+	u64 time;		// its CLOCK_MONOTONIC ns
+	u64 interval;	// source frame interval, ns
+};
+
+void qvio_sof_reset(struct qvio_sof* self, u64 interval);
+// sequence of the frame that started at time, advance moves the latest start of frame up to it
+u32 qvio_sof_frame(struct qvio_sof* self, u64 time, bool advance);
+// a start of frame interrupt at time, each one is the next frame
+u32 qvio_sof_irq(struct qvio_sof* self, u64 time);
+
+// capture channels of one card that stream and stamp frames together
+struct qvio_group {
+	spinlock_t lock;
+	u32 members;
+	u32 armed;
+
+	// group frame clock, members completing the same source frame take the same sequence,
+	// whatever each of them dropped before
+	struct qvio_sof sof;
+
+	// first completion of a frame sets its timestamp for the whole group
+	struct {
+		u32 sequence;
+		u64 timestamp;
+	} ts[QVIO_GROUP_TS_RING];
+};
+
+void qvio_group_init(struct qvio_group* self);
+
+int qvio_group_join(struct qvio_group* self, int channel);
+void qvio_group_leave(struct qvio_group* self, int channel);
+bool qvio_group_has(struct qvio_group* self, int channel);
+bool qvio_group_armed(struct qvio_group* self, int channel);
+
+// true if the caller should write streamon/streamoff on behalf of the group,
+// interval is the source frame interval of the member
+bool qvio_group_arm(struct qvio_group* self, int channel, u64 interval);
+bool qvio_group_disarm(struct qvio_group* self, int channel);
+
+// sequence of the source frame a member's frame started at time with,
+// advance unless the group clock is driven by qvio_group_sof_irq()
+u32 qvio_group_sequence(struct qvio_group* self, u64 time, bool advance);
+// the start of frame interrupt, seen by every member and counted once, false until the group streams
+bool qvio_group_sof_irq(struct qvio_group* self, u64 time, u32* sequence);
+// the first timestamp of a sequence is the whole group's
+u64 qvio_group_timestamp(struct qvio_group* self, u32 sequence, u64 timestamp);
+
+#endif // __QVIO_GROUP_H__
@@ -0,0 +1,349 @@
+#define pr_fmt(fmt)     "[" KBUILD_MODNAME "]%s(#%d): " fmt, __func__, __LINE__
+
+#include "i2c.h"
+#include "device.h"
+#include "libxdma_api.h"
+
+#include <linux/module.h>
+#include <linux/version.h>
+#include <linux/iopoll.h>
+
+static int i2c_irq = QVIO_I2C_IRQ_PROBE;
+module_param(i2c_irq, int, 0444);
+MODULE_PARM_DESC(i2c_irq, "User IRQ line of the card's I2C controller, -2 - the line that answers the controller at load (default), -1 - polled");
+
+// controller registers, from the start of the user BAR
+#define QVIO_I2C_BASE			0x3000
+#define QVIO_I2C_GIE			0x01C
+#define QVIO_I2C_ISR			0x020 // toggle on write
+#define QVIO_I2C_IER			0x028
+#define QVIO_I2C_SOFTR			0x040
+#define QVIO_I2C_CR				0x100
+#define QVIO_I2C_SR				0x104
+#define QVIO_I2C_TX_FIFO		0x108
+#define QVIO_I2C_RX_FIFO		0x10C
+#define QVIO_I2C_RX_PIRQ		0x120
+
+#define QVIO_I2C_GIE_EN			0x80000000
+#define QVIO_I2C_SOFTR_KEY		0x0000000A
+#define QVIO_I2C_CR_EN			0x00000001
+#define QVIO_I2C_CR_TX_RESET	0x00000002
+#define QVIO_I2C_TX_START		0x00000100
+#define QVIO_I2C_TX_STOP		0x00000200
+
+#define QVIO_I2C_INT_ARB_LOST	0x00000001
+#define QVIO_I2C_INT_TX_ERROR	0x00000002 // no ack
+#define QVIO_I2C_INT_TX_EMPTY	0x00000004
+#define QVIO_I2C_INT_RX_FULL	0x00000008 // RX_PIRQ + 1 bytes in the rx fifo
+#define QVIO_I2C_INT_BNB		0x00000010 // bus not busy
+#define QVIO_I2C_INT_ERRORS		(QVIO_I2C_INT_ARB_LOST | QVIO_I2C_INT_TX_ERROR)
+#define QVIO_I2C_INT_ALL		0x000000FF
+
+#define QVIO_I2C_FIFO_DEPTH		16
+#define QVIO_I2C_MAX_READ		255 // count byte of the dynamic read
+
+static inline u32 __i2c_read(struct qvio_i2c* self, u32 reg) {
+	return ioread32(self->base + reg);
+}
+
+static inline void __i2c_write(struct qvio_i2c* self, u32 reg, u32 value) {
+	iowrite32(value, self->base + reg);
+}
+
+static void __i2c_clear(struct qvio_i2c* self, u32 bits) {
+	u32 isr = __i2c_read(self, QVIO_I2C_ISR);
+
+	// level conditions still true are raised again right away
+	if(isr & bits)
+		__i2c_write(self, QVIO_I2C_ISR, isr & bits);
+}
+
+static void __i2c_reset(struct qvio_i2c* self) {
+	__i2c_write(self, QVIO_I2C_SOFTR, QVIO_I2C_SOFTR_KEY);
+	__i2c_write(self, QVIO_I2C_IER, 0);
+	__i2c_write(self, QVIO_I2C_RX_PIRQ, QVIO_I2C_FIFO_DEPTH - 1);
+	__i2c_write(self, QVIO_I2C_CR, QVIO_I2C_CR_TX_RESET);
+	__i2c_write(self, QVIO_I2C_CR, QVIO_I2C_CR_EN);
+	__i2c_write(self, QVIO_I2C_GIE, self->irq >= 0 ? QVIO_I2C_GIE_EN : 0);
+}
+
+// waits for any of the isr bits, a lost arbitration or a nak ends it too
+static int __i2c_wait(struct qvio_i2c* self, u32 bits) {
+	int err;
+	u32 isr;
+
+	bits |= QVIO_I2C_INT_ERRORS;
+	__i2c_clear(self, bits & ~QVIO_I2C_INT_ERRORS);
+
+	if(self->irq >= 0) {
+		reinit_completion(&self->done);
+		__i2c_write(self, QVIO_I2C_IER, bits);
+		wait_for_completion_timeout(&self->done, self->adap.timeout);
+		__i2c_write(self, QVIO_I2C_IER, 0);
+
+		isr = __i2c_read(self, QVIO_I2C_ISR);
+		err = (isr & bits) ? 0 : -ETIMEDOUT;
+	} else {
+		err = readl_poll_timeout(self->base + QVIO_I2C_ISR, isr, isr & bits,
+			5, jiffies_to_usecs(self->adap.timeout));
+	}
+
+	if(err) {
+		pr_err("timeout, bits=0x%02X isr=0x%02X sr=0x%02X\n", bits, isr, __i2c_read(self, QVIO_I2C_SR));
+		return err;
+	}
+
+	if(isr & QVIO_I2C_INT_ARB_LOST)
+		return -EAGAIN;
+
+	if(isr & QVIO_I2C_INT_TX_ERROR)
+		return -ENXIO;
+
+	return 0;
+}
+
+static int __i2c_write_msg(struct qvio_i2c* self, struct i2c_msg* msg, bool stop) {
+	int err;
+	u32 w;
+	int i, n;
+
+	__i2c_clear(self, QVIO_I2C_INT_ALL);
+	__i2c_write(self, QVIO_I2C_CR, QVIO_I2C_CR_TX_RESET);
+	__i2c_write(self, QVIO_I2C_CR, QVIO_I2C_CR_EN);
+
+	w = QVIO_I2C_TX_START | (msg->addr << 1);
+	if(msg->len == 0 && stop)
+		w |= QVIO_I2C_TX_STOP;
+	__i2c_write(self, QVIO_I2C_TX_FIFO, w);
+
+	// fifo entries queued since it was last empty
+	n = 1;
+	for(i = 0; i < msg->len; i++) {
+		if(n == QVIO_I2C_FIFO_DEPTH) {
+			err = __i2c_wait(self, QVIO_I2C_INT_TX_EMPTY);
+			if(err)
+				return err;
+
+			n = 0;
+		}
+
+		w = msg->buf[i];
+		if(i == msg->len - 1 && stop)
+			w |= QVIO_I2C_TX_STOP;
+		__i2c_write(self, QVIO_I2C_TX_FIFO, w);
+		n++;
+	}
+
+	// without a stop the bus is held for the repeated start of the next message
+	return __i2c_wait(self, stop ? QVIO_I2C_INT_BNB : QVIO_I2C_INT_TX_EMPTY);
+}
+
+// the dynamic read always ends with a stop
+static int __i2c_read_msg(struct qvio_i2c* self, struct i2c_msg* msg) {
+	int err;
+	int i, n;
+
+	if(msg->len == 0 || msg->len > QVIO_I2C_MAX_READ || (msg->flags & I2C_M_RECV_LEN)) {
+		pr_err("unexpected value, msg->len=%d msg->flags=0x%X\n", (int)msg->len, (int)msg->flags);
+		return -EOPNOTSUPP;
+	}
+
+	__i2c_write(self, QVIO_I2C_RX_PIRQ, min_t(int, msg->len, QVIO_I2C_FIFO_DEPTH) - 1);
+	__i2c_write(self, QVIO_I2C_CR, QVIO_I2C_CR_TX_RESET);
+	__i2c_write(self, QVIO_I2C_CR, 0);
+	__i2c_write(self, QVIO_I2C_TX_FIFO, QVIO_I2C_TX_START | (msg->addr << 1) | 1);
+	__i2c_write(self, QVIO_I2C_TX_FIFO, QVIO_I2C_TX_STOP | msg->len);
+	__i2c_clear(self, QVIO_I2C_INT_ALL);
+	__i2c_write(self, QVIO_I2C_CR, QVIO_I2C_CR_EN);
+
+	for(i = 0; i < msg->len;) {
+		n = min_t(int, msg->len - i, QVIO_I2C_FIFO_DEPTH);
+		__i2c_write(self, QVIO_I2C_RX_PIRQ, n - 1);
+
+		err = __i2c_wait(self, QVIO_I2C_INT_RX_FULL);
+		if(err)
+			return err;
+
+		while(n--)
+			msg->buf[i++] = (u8)__i2c_read(self, QVIO_I2C_RX_FIFO);
+	}
+
+	return __i2c_wait(self, QVIO_I2C_INT_BNB);
+}
+
+static int __i2c_xfer(struct i2c_adapter* adap, struct i2c_msg* msgs, int num) {
+	int err;
+	struct qvio_i2c* self = i2c_get_adapdata(adap);
+	int i;
+
+	if(self->qdev->xdev->flags & XDEV_FLAG_OFFLINE) {
+		pr_err("xdev 0x%p offline\n", self->qdev->xdev);
+		return -EBUSY;
+	}
+
+	for(i = 0; i < num; i++) {
+		if(msgs[i].flags & I2C_M_TEN) {
+			pr_err("unexpected value, msgs[%d].flags=0x%X\n", i, (int)msgs[i].flags);
+			err = -EOPNOTSUPP;
+			goto err0;
+		}
+
+		if(msgs[i].flags & I2C_M_RD)
+			err = __i2c_read_msg(self, &msgs[i]);
+		else
+			err = __i2c_write_msg(self, &msgs[i], i == num - 1);
+		if(err) {
+			dev_dbg(&adap->dev, "msgs[%d] addr=0x%02X len=%d, err=%d\n", i, (int)msgs[i].addr, (int)msgs[i].len, err);
+			goto err1;
+		}
+	}
+
+	return num;
+
+err1:
+	__i2c_reset(self);
+err0:
+	return err;
+}
+
+static u32 __i2c_func(struct i2c_adapter* adap) {
+	return I2C_FUNC_I2C | (I2C_FUNC_SMBUS_EMULATED & ~I2C_FUNC_SMBUS_QUICK);
+}
+
+static const struct i2c_algorithm __i2c_algo = {
+#if KERNEL_VERSION(6, 8, 0) <= LINUX_VERSION_CODE
+	.xfer = __i2c_xfer,
+#else
+	.master_xfer = __i2c_xfer,
+#endif
+	.functionality = __i2c_func,
+};
+
+// any user line may be the controller's, only one that finds it asserting takes it
+static irqreturn_t __i2c_probe_irq(int irq, void* dev) {
+	struct qvio_i2c* self = dev;
+
+	if(! (__i2c_read(self, QVIO_I2C_ISR) & __i2c_read(self, QVIO_I2C_IER)))
+		return IRQ_NONE;
+
+	__i2c_write(self, QVIO_I2C_IER, 0);
+	cmpxchg(&self->irq, -1, irq);
+	complete(&self->done);
+
+	return IRQ_HANDLED;
+}
+
+// the tx fifo is empty after a reset, its interrupt shows which user line the controller is wired to
+static int __i2c_probe(struct qvio_i2c* self) {
+	struct xdma_dev *xdev = self->qdev->xdev;
+	u32 lines = BIT(self->qdev->user_max) - 1;
+	int err;
+
+	if(! lines)
+		return -1;
+
+	self->irq = -1;
+	reinit_completion(&self->done);
+
+	err = xdma_user_isr_register(xdev, lines, __i2c_probe_irq, self);
+	if(err) {
+		pr_err("xdma_user_isr_register() failed, err=%d\n", err);
+		return -1;
+	}
+
+	__i2c_write(self, QVIO_I2C_GIE, QVIO_I2C_GIE_EN);
+	__i2c_write(self, QVIO_I2C_IER, QVIO_I2C_INT_TX_EMPTY);
+	wait_for_completion_timeout(&self->done, msecs_to_jiffies(20));
+	__i2c_write(self, QVIO_I2C_IER, 0);
+	__i2c_write(self, QVIO_I2C_GIE, 0);
+
+	xdma_user_isr_register(xdev, lines, NULL, NULL);
+
+	return READ_ONCE(self->irq);
+}
+
+irqreturn_t qvio_i2c_irq(int irq, void* dev) {
+	struct qvio_i2c* self = dev;
+
+	// masked until the next wait, the waiter reads the isr
+	__i2c_write(self, QVIO_I2C_IER, 0);
+	complete(&self->done);
+
+	return IRQ_HANDLED;
+}
+
+int qvio_i2c_start(struct qvio_i2c* self, struct qvio_device* qdev) {
+	int err;
+	struct xdma_dev *xdev = qdev->xdev;
+
+	self->qdev = qdev;
+	self->base = xdev->bar[xdev->user_bar_idx] + QVIO_I2C_BASE;
+	init_completion(&self->done);
+
+	self->irq = i2c_irq;
+	if(self->irq == QVIO_I2C_IRQ_PROBE) {
+		self->irq = -1;
+		__i2c_reset(self);
+
+		self->irq = __i2c_probe(self);
+		if(self->irq < 0)
+			pr_warn("no user IRQ line answers the I2C controller, polled\n");
+		else
+			pr_info("i2c_irq=%d\n", self->irq);
+	}
+
+	if(self->irq >= qdev->user_max) {
+		pr_warn("unexpected value, i2c_irq=%d user_max=%d, polled\n", i2c_irq, qdev->user_max);
+		self->irq = -1;
+	}
+
+	if(self->irq >= 0) {
+		err = xdma_user_isr_register(xdev, BIT(self->irq), qvio_i2c_irq, self);
+		if(err) {
+			pr_err("xdma_user_isr_register() failed, err=%d\n", err);
+			goto err0;
+		}
+	}
+
+	__i2c_reset(self);
+
+	self->adap.owner = THIS_MODULE;
+	self->adap.algo = &__i2c_algo;
+	self->adap.timeout = msecs_to_jiffies(100);
+	self->adap.retries = 0;
+	self->adap.dev.parent = qdev->dev;
+	snprintf(self->adap.name, sizeof(self->adap.name), "qvio-i2c %s", dev_name(qdev->dev));
+	i2c_set_adapdata(&self->adap, self);
+
+	err = i2c_add_adapter(&self->adap);
+	if(err) {
+		pr_err("i2c_add_adapter() failed, err=%d\n", err);
+		goto err1;
+	}
+
+	self->started = true;
+
+	return 0;
+
+err1:
+	if(self->irq >= 0) {
+		__i2c_write(self, QVIO_I2C_GIE, 0);
+		xdma_user_isr_register(xdev, BIT(self->irq), NULL, NULL);
+	}
+err0:
+	return err;
+}
+
+void qvio_i2c_stop(struct qvio_i2c* self) {
+	if(! self->started)
+		return;
+
+	i2c_del_adapter(&self->adap);
+
+	__i2c_write(self, QVIO_I2C_GIE, 0);
+	__i2c_write(self, QVIO_I2C_IER, 0);
+	if(self->irq >= 0)
+		xdma_user_isr_register(self->qdev->xdev, BIT(self->irq), NULL, NULL);
+
+	self->started = false;
+}
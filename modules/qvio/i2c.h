@@ -0,0 +1,31 @@
+#ifndef __QVIO_I2C_H__
+#define __QVIO_I2C_H__
+
+#include <linux/i2c.h>
+#include <linux/completion.h>
+
+struct qvio_device;
+
+// i2c_irq default, completion-driven on the line found at load, polled only if none answers
+#define QVIO_I2C_IRQ_PROBE -2
+
+// i2c master on the card's BAR-mapped I2C FIFO controller
+struct qvio_i2c {
+	struct i2c_adapter adap;
+	struct qvio_device* qdev;
+	void __iomem* base;
+
+	// user IRQ line of the controller, -1 if polled
+	int irq;
+	struct completion done;
+
+	bool started;
+};
+
+int qvio_i2c_start(struct qvio_i2c* self, struct qvio_device* qdev);
+void qvio_i2c_stop(struct qvio_i2c* self);
+
+// user IRQ handler, dev is the qvio_i2c
+irqreturn_t qvio_i2c_irq(int irq, void* dev);
+
+#endif // __QVIO_I2C_H__
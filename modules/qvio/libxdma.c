@@ -26,6 +26,7 @@
 #include <linux/errno.h>
 #include <linux/sched.h>
 #include <linux/vmalloc.h>
+#include <linux/delay.h>
 
 #include "libxdma.h"
 #include "libxdma_api.h"
@@ -50,6 +51,18 @@ module_param(desc_blen_max, uint, 0644);
 MODULE_PARM_DESC(desc_blen_max,
 		 "per descriptor max. buffer length, default is (1 << 28) - 1");
 
+static unsigned int cmpl_rt_prio;
+module_param(cmpl_rt_prio, uint, 0444);
+MODULE_PARM_DESC(cmpl_rt_prio,
+	"SCHED_FIFO priority (1-99) of a dedicated completion thread per C2H engine, default is 0 (shared workqueue or poll threads)");
+
+static int cmpl_rt_cpu[XDMA_CHANNEL_NUM_MAX] = {
+	[0 ... XDMA_CHANNEL_NUM_MAX - 1] = -1
+};
+module_param_array(cmpl_rt_cpu, int, NULL, 0444);
+MODULE_PARM_DESC(cmpl_rt_cpu,
+	"CPU of the dedicated completion thread per C2H channel, default is -1 (any, a CPU near the device in poll mode)");
+
 #define XDMA_PERF_NUM_DESC 128
 
 /* Kernel version adaptative code */
@@ -1211,14 +1224,12 @@ done:
 	return err_flag ? -1 : 0;
 }
 
-/* engine_service_work */
-static void engine_service_work(struct work_struct *work)
+/* engine_service_bh */
+static void engine_service_bh(struct xdma_engine *engine)
 {
-	struct xdma_engine *engine;
 	unsigned long flags;
 	int rv;
 
-	engine = container_of(work, struct xdma_engine, work);
 	if (engine->magic != MAGIC_ENGINE) {
 		pr_err("%s has invalid magic number %lx\n", engine->name,
 		       engine->magic);
@@ -1251,6 +1262,26 @@ unlock:
 	spin_unlock_irqrestore(&engine->lock, flags);
 }
 
+/* engine_service_work */
+static void engine_service_work(struct work_struct *work)
+{
+	engine_service_bh(container_of(work, struct xdma_engine, work));
+}
+
+/* engine_service_kwork - on the engine's own SCHED_FIFO worker */
+static void engine_service_kwork(struct kthread_work *work)
+{
+	engine_service_bh(container_of(work, struct xdma_engine, cmpl_work));
+}
+
+static inline void engine_schedule_service(struct xdma_engine *engine)
+{
+	if (engine->cmpl_worker)
+		kthread_queue_work(engine->cmpl_worker, &engine->cmpl_work);
+	else
+		schedule_work(&engine->work);
+}
+
 static u32 engine_service_wb_monitor(struct xdma_engine *engine,
 				     u32 expected_wb)
 {
@@ -1440,7 +1471,7 @@ static irqreturn_t xdma_isr(int irq, void *dev_id)
 			    (engine->magic == MAGIC_ENGINE)) {
 				mask &= ~engine->irq_bitmask;
 				dbg_tfr("schedule_work, %s.\n", engine->name);
-				schedule_work(&engine->work);
+				engine_schedule_service(engine);
 			}
 		}
 	}
@@ -1459,7 +1490,7 @@ static irqreturn_t xdma_isr(int irq, void *dev_id)
 			    (engine->magic == MAGIC_ENGINE)) {
 				mask &= ~engine->irq_bitmask;
 				dbg_tfr("schedule_work, %s.\n", engine->name);
-				schedule_work(&engine->work);
+				engine_schedule_service(engine);
 			}
 		}
 	}
@@ -1526,7 +1557,7 @@ static irqreturn_t xdma_channel_irq(int irq, void *dev_id)
 	/* Dummy read to flush the above write */
 	read_register(&irq_regs->channel_int_pending);
 	/* Schedule the bottom half */
-	schedule_work(&engine->work);
+	engine_schedule_service(engine);
 
 	/*
 	 * need to protect access here if multiple MSI-X are used for
@@ -2629,6 +2660,12 @@ static int engine_destroy(struct xdma_dev *xdev, struct xdma_engine *engine)
 	if (poll_mode)
 		xdma_thread_remove_work(engine);
 
+	/* flushes the bottom half still queued */
+	if (engine->cmpl_worker) {
+		kthread_destroy_worker(engine->cmpl_worker);
+		engine->cmpl_worker = NULL;
+	}
+
 	/* Release memory use for descriptor writebacks */
 	engine_free_resource(engine);
 
@@ -2847,6 +2884,55 @@ err_out:
 	return -ENOMEM;
 }
 
+/* dedicated SCHED_FIFO completion thread of a C2H engine, see cmpl_rt_prio */
+static int engine_cmpl_rt_start(struct xdma_engine *engine)
+{
+	struct xdma_dev *xdev = engine->xdev;
+	struct kthread_worker *worker;
+	int prio = min_t(unsigned int, cmpl_rt_prio, MAX_RT_PRIO - 1);
+	int cpu = cmpl_rt_cpu[engine->channel];
+	int rv;
+
+	if (cpu >= 0 && (cpu >= nr_cpu_ids || !cpu_online(cpu))) {
+		pr_warn("%s, cpu %d not online, any.\n", engine->name, cpu);
+		cpu = -1;
+	}
+
+	if (poll_mode) {
+		/* a polling thread is always bound */
+		if (cpu < 0)
+			cpu = cpumask_local_spread(engine->channel,
+					dev_to_node(&xdev->pdev->dev));
+
+		return xdma_thread_add_work_rt(engine, prio, cpu);
+	}
+
+#if KERNEL_VERSION(6, 14, 0) <= LINUX_VERSION_CODE
+	worker = kthread_run_worker(0, "qvio-%s", engine->name);
+#else
+	worker = kthread_create_worker(0, "qvio-%s", engine->name);
+#endif
+	if (IS_ERR(worker)) {
+		pr_err("%s, create worker failed: %ld\n", engine->name,
+			PTR_ERR(worker));
+		return PTR_ERR(worker);
+	}
+
+	rv = xdma_kthread_set_fifo(worker->task, prio, cpu);
+	if (rv < 0) {
+		kthread_destroy_worker(worker);
+		return rv;
+	}
+
+	/* the ISR picks the worker from here on */
+	kthread_init_work(&engine->cmpl_work, engine_service_kwork);
+	engine->cmpl_worker = worker;
+
+	pr_info("%s, completion on %s, prio %d, cpu %d.\n", engine->name,
+		worker->task->comm, prio, cpu);
+	return 0;
+}
+
 static int engine_init(struct xdma_engine *engine, struct xdma_dev *xdev,
 		       int offset, enum dma_data_direction dir, int channel)
 {
@@ -2907,6 +2993,15 @@ static int engine_init(struct xdma_engine *engine, struct xdma_dev *xdev,
 	if (rv)
 		return rv;
 
+	if (cmpl_rt_prio && dir == DMA_FROM_DEVICE) {
+		rv = engine_cmpl_rt_start(engine);
+		if (rv == 0)
+			return 0;
+
+		pr_warn("%s, no dedicated completion thread, rv %d.\n",
+			engine->name, rv);
+	}
+
 	if (poll_mode)
 		xdma_thread_add_work(engine);
 
@@ -3963,6 +4058,10 @@ ssize_t xdma_xfer_completion(void *cb_hndl, void *dev_hndl, int channel,
 #endif
 			rv = -EIO;
 			break;
+		case TRANSFER_STATE_ABORTED:
+			/* drained by xdma_engine_offline() */
+			rv = -ECANCELED;
+			break;
 		default:
 			/* transfer can still be in-flight */
 			pr_info("xfer 0x%p,%u, s 0x%x timed out, ep 0x%llx.\n",
@@ -3999,7 +4098,8 @@ unmap_sgl:
 	if (req)
 		xdma_request_free(req);
 
-	return done;
+	/* as long as some data is processed, return the count */
+	return done ? done : rv;
 
 }
 
@@ -4865,6 +4965,134 @@ void xdma_device_online(struct pci_dev *pdev, void *dev_hndl)
 	pr_info("xdev 0x%p, done.\n", xdev);
 }
 
+static struct xdma_engine *engine_find(struct xdma_dev *xdev, int channel,
+				       bool write)
+{
+	struct xdma_engine *engine;
+
+	if (write) {
+		if (channel < 0 || channel >= xdev->h2c_channel_max) {
+			pr_warn("H2C channel %d >= %d.\n",
+				channel, xdev->h2c_channel_max);
+			return NULL;
+		}
+		engine = &xdev->engine_h2c[channel];
+	} else {
+		if (channel < 0 || channel >= xdev->c2h_channel_max) {
+			pr_warn("C2H channel %d >= %d.\n",
+				channel, xdev->c2h_channel_max);
+			return NULL;
+		}
+		engine = &xdev->engine_c2h[channel];
+	}
+
+	if (engine->magic != MAGIC_ENGINE) {
+		pr_err("%s has invalid magic number %lx\n", engine->name,
+		       engine->magic);
+		return NULL;
+	}
+
+	return engine;
+}
+
+int xdma_engine_offline(void *dev_hndl, int channel, bool write)
+{
+	struct xdma_dev *xdev = (struct xdma_dev *)dev_hndl;
+	struct xdma_engine *engine;
+	struct xdma_transfer *transfer;
+	unsigned long flags;
+	int i;
+	int rv;
+
+	if (!dev_hndl)
+		return -EINVAL;
+
+	if (debug_check_dev_hndl(__func__, xdev->pdev, dev_hndl) < 0)
+		return -EINVAL;
+
+	engine = engine_find(xdev, channel, write);
+	if (!engine)
+		return -EINVAL;
+
+	pr_info("engine %s.\n", engine->name);
+
+	/* no new transfers from here on */
+	spin_lock_irqsave(&engine->lock, flags);
+	engine->shutdown |= ENGINE_SHUTDOWN_REQUEST;
+
+	rv = xdma_engine_stop(engine);
+	if (rv < 0)
+		pr_err("Failed to stop engine\n");
+	spin_unlock_irqrestore(&engine->lock, flags);
+
+	/* RUN is sampled per descriptor, let the one in flight land */
+	for (i = 0; i < 100; i++) {
+		if (!(read_register(&engine->regs->status) & XDMA_STAT_BUSY))
+			break;
+		usleep_range(100, 200);
+	}
+	if (i == 100)
+		pr_warn("engine %s still busy.\n", engine->name);
+
+	/* drain, the owners see TRANSFER_STATE_ABORTED at completion */
+	spin_lock_irqsave(&engine->lock, flags);
+	engine_status_read(engine, 1, 0);
+
+	while (!list_empty(&engine->transfer_list)) {
+		transfer = list_entry(engine->transfer_list.next,
+				      struct xdma_transfer, entry);
+		list_del(engine->transfer_list.next);
+
+		transfer->state = TRANSFER_STATE_ABORTED;
+		engine_transfer_completion(engine, transfer);
+	}
+	engine->desc_dequeued = 0;
+	spin_unlock_irqrestore(&engine->lock, flags);
+
+	return rv;
+}
+
+int xdma_engine_online(void *dev_hndl, int channel, bool write)
+{
+	struct xdma_dev *xdev = (struct xdma_dev *)dev_hndl;
+	struct xdma_engine *engine;
+	unsigned long flags;
+	int rv;
+
+	if (!dev_hndl)
+		return -EINVAL;
+
+	if (debug_check_dev_hndl(__func__, xdev->pdev, dev_hndl) < 0)
+		return -EINVAL;
+
+	if (xdma_device_flag_check(xdev, XDEV_FLAG_OFFLINE)) {
+		pr_info("xdev 0x%p, offline.\n", xdev);
+		return -EBUSY;
+	}
+
+	engine = engine_find(xdev, channel, write);
+	if (!engine)
+		return -EINVAL;
+
+	pr_info("engine %s.\n", engine->name);
+
+	rv = engine_init_regs(engine);
+	if (rv < 0) {
+		pr_err("Failed to init engine %s regs\n", engine->name);
+		return rv;
+	}
+
+	spin_lock_irqsave(&engine->lock, flags);
+	engine->shutdown = ENGINE_SHUTDOWN_NONE;
+	spin_unlock_irqrestore(&engine->lock, flags);
+
+	/* the drain may have left it masked, see engine_service_work() */
+	if (!poll_mode)
+		channel_interrupts_enable(xdev, engine->irq_bitmask);
+
+	return 0;
+}
+
 int xdma_device_restart(struct pci_dev *pdev, void *dev_hndl)
 {
 	struct xdma_dev *xdev = (struct xdma_dev *)dev_hndl;
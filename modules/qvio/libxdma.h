@@ -31,6 +31,7 @@
 #include <linux/kernel.h>
 #include <linux/pci.h>
 #include <linux/workqueue.h>
+#include <linux/kthread.h>
 
 /* Add compatibility checking for RHEL versions */
 #if defined(RHEL_RELEASE_CODE)
@@ -566,6 +567,9 @@ struct xdma_engine {
 	int msix_irq_line;		/* MSI-X vector for this engine */
 	u32 irq_bitmask;		/* IRQ bit mask for this engine */
 	struct work_struct work;	/* Work queue for interrupt handling */
+	/* SCHED_FIFO bottom half instead of work, see cmpl_rt_prio */
+	struct kthread_worker *cmpl_worker;
+	struct kthread_work cmpl_work;
 
 	struct mutex desc_lock;		/* protects concurrent access */
 	dma_addr_t desc_bus;
@@ -584,6 +588,8 @@ struct xdma_engine {
 #endif // NONEED
 
 	struct xdma_kthread *cmplthp;
+	/* cmplthp is this engine's own SCHED_FIFO thread, not a shared one */
+	int cmplthp_rt;
 	/* completion status thread list for the queue */
 	struct list_head cmplthp_list;
 	/* pending work thread list */
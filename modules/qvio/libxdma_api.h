@@ -140,7 +140,23 @@ ssize_t xdma_xfer_submit_nowait(void *cb_hndl, void *dev_hndl, int channel, bool
 ssize_t xdma_xfer_completion(void *cb_hndl, void *dev_hndl, int channel, bool write, u64 ep_addr,
 			struct sg_table *sgt, bool dma_mapped, int timeout_ms);
 
-			
+
+/*
+ * xdma_engine_offline - stop one engine, the rest of the device keeps running
+ *	transfers still queued complete with TRANSFER_STATE_ABORTED, through
+ *	io_done for the nowait ones, and new ones are refused until online
+ * @channel: channel number (< channel_max)
+ * @write: the H2C engine of the channel, C2H otherwise
+ * return < 0 in case of error
+ */
+int xdma_engine_offline(void *dev_hndl, int channel, bool write);
+
+/*
+ * xdma_engine_online - reinitialize the registers of an offline engine and
+ * accept transfers on it again
+ * return < 0 in case of error
+ */
+int xdma_engine_online(void *dev_hndl, int channel, bool write);
 
 /////////////////////missing API////////////////////
 
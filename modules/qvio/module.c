@@ -2,6 +2,7 @@
 
 #include <linux/init.h>
 #include <linux/module.h>
+#include <linux/version.h>
 
 #include "version.h"
 #include "cdev.h"
@@ -17,6 +18,13 @@ MODULE_DESCRIPTION(DRV_MODULE_DESC);
 MODULE_VERSION(DRV_MODULE_VERSION);
 MODULE_LICENSE("GPL");
 
+// dma_buf_get()/dma_buf_mmap() for the daemon's BUF_INIT dma-bufs
+#if KERNEL_VERSION(6, 13, 0) <= LINUX_VERSION_CODE
+MODULE_IMPORT_NS("DMA_BUF");
+#elif KERNEL_VERSION(5, 16, 0) <= LINUX_VERSION_CODE
+MODULE_IMPORT_NS(DMA_BUF);
+#endif
+
 static int __init qvio_mod_init(void)
 {
 	int err;
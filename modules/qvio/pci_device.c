@@ -4,6 +4,7 @@
 #include "device.h"
 
 #include <linux/aer.h>
+#include <linux/iopoll.h>
 
 #define DRV_MODULE_NAME "qvio-pci"
 
@@ -38,7 +39,7 @@ static ssize_t __file_read(struct file *filp, char __user *buf, size_t count, lo
 	/* first address is BAR base plus file position offset */
 	reg = xdev->bar[xdev->user_bar_idx] + *pos;
 	//w = read_register(reg);
-	w = ioread32(reg);
+	w = qvio_regs_read(&self->regs, (u32)*pos);
 	dbg_sg("%s(@%p, count=%ld, pos=%d) value = 0x%08x\n",
 			__func__, reg, (long)count, (int)*pos, w);
 	rv = copy_to_user(buf, &w, 4);
@@ -80,7 +81,8 @@ static ssize_t __file_write(struct file *filp, const char __user *buf, size_t co
 	dbg_sg("%s(0x%08x @%p, count=%ld, pos=%d)\n",
 			__func__, w, reg, (long)count, (int)*pos);
 	//write_register(w, reg);
-	iowrite32(w, reg);
+	qvio_regs_write(&self->regs, (u32)*pos, w);
+	qvio_regs_flush(&self->regs);
 #endif // USE_LIBXDMA
 
 	*pos += 4;
@@ -155,6 +157,146 @@ static int __file_mmap(struct file *filp, struct vm_area_struct *vma)
 	return 0;
 }
 
+#if 1 // USE_LIBXDMA
+static int __reg_ops(struct qvio_device* self, struct qvio_reg_ops __user* arg)
+{
+	int err;
+	struct xdma_dev *xdev = self->xdev;
+	struct qvio_reg_ops reg_ops;
+	struct qvio_reg_op* ops;
+	struct qvio_reg_op* op;
+	void __iomem *bar;
+	void __iomem *reg;
+	resource_size_t bar_len;
+	u32 i, w, copied;
+
+	if (copy_from_user(&reg_ops, arg, sizeof(reg_ops))) {
+		pr_err("copy_from_user() failed\n");
+		err = -EFAULT;
+		goto err0;
+	}
+
+	if (reg_ops.count == 0 || reg_ops.count > QVIO_REG_OPS_MAX) {
+		pr_err("unexpected value, reg_ops.count=%u\n", reg_ops.count);
+		err = -EINVAL;
+		goto err0;
+	}
+
+	if (xdev->flags & XDEV_FLAG_OFFLINE) {
+		pr_err("xdev 0x%p offline\n", xdev);
+		err = -EBUSY;
+		goto err0;
+	}
+
+	ops = memdup_user(u64_to_user_ptr(reg_ops.ops), sizeof(*ops) * reg_ops.count);
+	if (IS_ERR(ops)) {
+		err = PTR_ERR(ops);
+		pr_err("memdup_user() failed, err=%d\n", err);
+		goto err0;
+	}
+
+	bar = xdev->bar[xdev->user_bar_idx];
+	bar_len = min_t(resource_size_t, pci_resource_len(xdev->pdev, xdev->user_bar_idx), INT_MAX);
+
+	err = 0;
+	mutex_lock(&self->reg_mutex);
+	if (reg_ops.flags & QVIO_REG_OPS_F_UNCACHED)
+		qvio_regs_invalidate(&self->regs);
+
+	for (i = 0; i < reg_ops.count; i++) {
+		op = &ops[i];
+
+		/* only 32-bit aligned, inside the mapped BAR */
+		if ((op->offset & 3) || op->offset > bar_len - 4) {
+			pr_err("unexpected value, ops[%u].offset=0x%x\n", i, op->offset);
+			err = -EINVAL;
+			break;
+		}
+
+		reg = bar + op->offset;
+		switch (op->op) {
+		// through the shadow, writes reach the card in entry order
+		case QVIO_REG_OP_READ:
+			op->value = qvio_regs_read(&self->regs, op->offset);
+			break;
+
+		case QVIO_REG_OP_WRITE:
+			qvio_regs_write(&self->regs, op->offset, op->value);
+			qvio_regs_flush(&self->regs);
+			break;
+
+		case QVIO_REG_OP_RMW:
+			op->value = qvio_regs_update(&self->regs, op->offset, op->mask, op->value);
+			qvio_regs_flush(&self->regs);
+			break;
+
+		case QVIO_REG_OP_POLL:
+			if (reg_ops.timeout_us) {
+				err = readl_poll_timeout(reg, w, (w & op->mask) == (op->value & op->mask),
+					10, reg_ops.timeout_us);
+			} else {
+				w = ioread32(reg);
+				if ((w & op->mask) != (op->value & op->mask))
+					err = -ETIMEDOUT;
+			}
+			op->value = w;
+			break;
+
+		default:
+			pr_err("unexpected value, ops[%u].op=%u\n", i, op->op);
+			err = -EINVAL;
+			break;
+		}
+
+		if (err)
+			break;
+	}
+	mutex_unlock(&self->reg_mutex);
+
+	// values up to and including the failed entry
+	reg_ops.done = i;
+	copied = min(i + 1, reg_ops.count);
+	if (copy_to_user(u64_to_user_ptr(reg_ops.ops), ops, sizeof(*ops) * copied) ||
+		copy_to_user(arg, &reg_ops, sizeof(reg_ops))) {
+		pr_err("copy_to_user() failed\n");
+		err = -EFAULT;
+	}
+
+	kfree(ops);
+
+	return err;
+
+err0:
+	return err;
+}
+#endif // USE_LIBXDMA
+
+static long __engine_ioctl(struct qvio_device* self, unsigned int cmd, u32 __user* arg)
+{
+	u32 channel;
+
+	if (get_user(channel, arg)) {
+		pr_err("get_user() failed\n");
+		return -EFAULT;
+	}
+
+	if (channel >= self->c2h_channel_max) {
+		pr_err("unexpected value, channel=%u c2h_channel_max=%d\n", channel, self->c2h_channel_max);
+		return -EINVAL;
+	}
+
+	switch (cmd) {
+	case QVID_IOC_ENGINE_OFFLINE:
+		return qvio_device_engine_offline(self, channel);
+
+	case QVID_IOC_ENGINE_ONLINE:
+		return qvio_device_engine_online(self, channel);
+
+	default:
+		return qvio_device_engine_reset(self, channel);
+	}
+}
+
 static long __file_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
 	struct qvio_device* self = filp->private_data;
@@ -167,7 +309,8 @@ static long __file_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		pr_info("cmd %u, xdev NULL.\n", cmd);
 		return -EINVAL;
 	}
-	pr_info("cmd 0x%x, xdev 0x%p, pdev 0x%p.\n", cmd, xdev, xdev->pdev);
+	if (cmd == QVID_IOC_IOCOFFLINE || cmd == QVID_IOC_IOCONLINE)
+		pr_info("cmd 0x%x, xdev 0x%p, pdev 0x%p.\n", cmd, xdev, xdev->pdev);
 #endif // USE_LIBXDMA
 
 	if (_IOC_TYPE(cmd) != QVID_IOC_MAGIC) {
@@ -186,6 +329,19 @@ static long __file_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		qvio_device_xdma_online(self, xdev->pdev);
 		break;
 
+	case QVID_IOC_REG_OPS:
+		return __reg_ops(self, (struct qvio_reg_ops __user*)arg);
+
+	case QVID_IOC_USER_IRQ_GET:
+	case QVID_IOC_USER_IRQ_S_MASK:
+	case QVID_IOC_USER_IRQ_EVENTFD:
+		return qvio_user_irq_ioctl(&self->user_irq, cmd, arg);
+
+	case QVID_IOC_ENGINE_OFFLINE:
+	case QVID_IOC_ENGINE_ONLINE:
+	case QVID_IOC_ENGINE_RESET:
+		return __engine_ioctl(self, cmd, (u32 __user*)arg);
+
 	default:
 		pr_err("UNKNOWN ioctl cmd 0x%x.\n", cmd);
 		return -ENOTTY;
@@ -195,6 +351,13 @@ static long __file_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	return 0;
 }
 
+static __poll_t __file_poll(struct file *filp, struct poll_table_struct *wait)
+{
+	struct qvio_device* self = filp->private_data;
+
+	return qvio_user_irq_poll(&self->user_irq, filp, wait);
+}
+
 static const struct file_operations __fops = {
 	.owner = THIS_MODULE,
 	.open = qvio_cdev_open,
@@ -202,6 +365,7 @@ static const struct file_operations __fops = {
 	.read = __file_read,
 	.write = __file_write,
 	.mmap = __file_mmap,
+	.poll = __file_poll,
 	.unlocked_ioctl = __file_ioctl,
 };
 
@@ -237,6 +401,8 @@ static int __pci_probe(struct pci_dev *pdev, const struct pci_device_id *id) {
 		goto err1;
 	}
 
+	qvio_regs_init(&self->regs, self->xdev->bar[self->xdev->user_bar_idx]);
+
 	self->cdev.fops = &__fops;
 	self->cdev.private_data = self;
 	err = qvio_cdev_start(&self->cdev);
@@ -245,11 +411,24 @@ static int __pci_probe(struct pci_dev *pdev, const struct pci_device_id *id) {
 		goto err2;
 	}
 
+	err = qvio_i2c_start(&self->i2c, self);
+	if(err) {
+		pr_err("qvio_i2c_start() failed, err=%d\n", err);
+		goto err3;
+	}
+
+	err = qvio_user_irq_start(&self->user_irq, self,
+		self->i2c.irq >= 0 ? ~BIT(self->i2c.irq) : ~0U);
+	if(err) {
+		pr_err("qvio_user_irq_start() failed, err=%d\n", err);
+		goto err4;
+	}
+
 	self->video[0] = qvio_video_new();
 	if(! self) {
 		pr_err("qvio_video_new() failed\n");
 		err = -ENOMEM;
-		goto err3;
+		goto err5;
 	}
 
 	self->video[0]->qdev = self;
@@ -277,7 +456,7 @@ static int __pci_probe(struct pci_dev *pdev, const struct pci_device_id *id) {
 
 	default:
 		pr_err("unexpected value, self->device_id=0x%08X\n", self->device_id);
-		goto err4;
+		goto err5;
 		break;
 	}
 
@@ -286,13 +465,20 @@ static int __pci_probe(struct pci_dev *pdev, const struct pci_device_id *id) {
 	err = qvio_video_start(self->video[0]);
 	if(err) {
 		pr_err("qvio_qvio_start() failed, err=%d\n", err);
-		goto err4;
+		goto err5;
 	}
 
 	return 0;
 
+err5:
+	// no user IRQ reaches the video node from here on
+	qvio_user_irq_stop(&self->user_irq);
+	if(self->video[0]) {
+		qvio_video_put(self->video[0]);
+		self->video[0] = NULL;
+	}
 err4:
-	qvio_video_put(self->video[0]);
+	qvio_i2c_stop(&self->i2c);
 err3:
 	qvio_cdev_stop(&self->cdev);
 err2:
@@ -311,8 +497,11 @@ static void __pci_remove(struct pci_dev *pdev) {
 	if (! self)
 		return;
 
+	// no user IRQ reaches the video node from here on
+	qvio_user_irq_stop(&self->user_irq);
 	qvio_video_stop(self->video[0]);
 	qvio_video_put(self->video[0]);
+	qvio_i2c_stop(&self->i2c);
 	qvio_cdev_stop(&self->cdev);
 	qvio_device_xdma_close(self);
 	qvio_device_put(self);
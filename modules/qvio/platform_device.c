@@ -91,8 +91,36 @@ static int __probe(struct platform_device *pdev) {
 		goto err2;
 	}
 
+	// output, queued buffers become BUF_DONE jobs for the daemon
+	self->video[1] = qvio_video_new();
+	if(! self->video[1]) {
+		pr_err("qvio_video_new() failed\n");
+		err = -ENOMEM;
+		goto err3;
+	}
+
+	self->video[1]->qdev = self;
+	self->video[1]->user_job_ctrl.enable = true;
+
+	self->video[1]->vfl_dir = VFL_DIR_TX;
+	self->video[1]->buffer_type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+	self->video[1]->device_caps = V4L2_CAP_VIDEO_OUTPUT | V4L2_CAP_STREAMING;
+	snprintf(self->video[1]->bus_info, sizeof(self->video[1]->bus_info), "platform");
+	snprintf(self->video[1]->v4l2_dev.name, sizeof(self->video[1]->v4l2_dev.name), "qvio-tx");
+
+	err = qvio_video_start(self->video[1]);
+	if(err) {
+		pr_err("qvio_qvio_start() failed, err=%d\n", err);
+		goto err4;
+	}
+
 	return 0;
 
+err4:
+	qvio_video_put(self->video[1]);
+	self->video[1] = NULL;
+err3:
+	qvio_video_stop(self->video[0]);
 err2:
 	qvio_video_put(self->video[0]);
 err1:
@@ -108,6 +136,8 @@ static int __remove(struct platform_device *pdev) {
 
 	pr_info("\n");
 
+	qvio_video_stop(self->video[1]);
+	qvio_video_put(self->video[1]);
 	qvio_video_stop(self->video[0]);
 	qvio_video_put(self->video[0]);
 	qvio_cdev_stop(&self->cdev);
@@ -7,12 +7,62 @@
 
 #include <linux/version.h>
 #include <linux/kernel.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/moduleparam.h>
 #include <media/videobuf2-v4l2.h>
 #include <media/videobuf2-vmalloc.h>
+#include <media/v4l2-event.h>
+#include <linux/dma-buf.h>
+#include <linux/vmalloc.h>
+
+static unsigned int slices = 1;
+module_param(slices, uint, 0644);
+MODULE_PARM_DESC(slices, "Number of horizontal slices per capture buffer, default is 1 (whole frame)");
+
+static int deadline_fallback = QVIO_DEADLINE_OFF;
+module_param(deadline_fallback, int, 0644);
+MODULE_PARM_DESC(deadline_fallback, "Frames missed by the user-job daemon, 0 - wait (default), 1 - repeat the last good frame, 2 - black slate");
+
+static int frame_clock = 0;
+module_param(frame_clock, int, 0644);
+MODULE_PARM_DESC(frame_clock, "Pace user-job capture on frame boundaries from VIDIOC_S_PARM, 0 - off (default), 1 - on");
+
+static int watchdog_frames = 0;
+module_param(watchdog_frames, int, 0644);
+MODULE_PARM_DESC(watchdog_frames, "Frame intervals a capture transfer may take before its engine is reset, 0 - off (default)");
+
+static int frame_sync_irq = -1;
+module_param(frame_sync_irq, int, 0444);
+MODULE_PARM_DESC(frame_sync_irq, "User IRQ line the card raises at the start of each frame, -1 - none, V4L2_EVENT_FRAME_SYNC at the first slice of each frame instead if slices > 1 (default)");
+
+// dropped frames are written over and over into this small coherent block
+#define QVIO_SCRATCH_SIZE (128 * 1024)
+
+struct qvio_queue_buffer;
+
+#if 1 // USE_LIBXDMA
+static int __buf_submit(struct qvio_queue* self, struct qvio_queue_buffer* buf);
+#endif // USE_LIBXDMA
+static enum hrtimer_restart __deadline_timer(struct hrtimer* timer);
+static void __deadline_work(struct work_struct* work);
+static void __watchdog_work(struct work_struct* work);
+
+struct qvio_queue_slice {
+	struct qvio_queue_buffer* buf;
+	int index;
+	int offset;
+	int size;
+	int rows;
+
+	struct sg_table sgt;
+	struct xdma_io_cb io_cb;
+};
 
 struct qvio_queue_buffer {
 	struct vb2_v4l2_buffer vb;
 	struct list_head list_ready;
+	struct list_head list_posted;
 
 	// user-job buf-init
 	struct {
@@ -23,17 +73,60 @@ struct qvio_queue_buffer {
 		int psize[4];
 	} buf_init;
 
+	// daemon's dma-buf adopted as the mmap backing, under vb2_queue.mmap_lock
+	struct dma_buf* dmabuf;
+
 	// vb2_buffer dma access
 	struct sg_table sgt;
 	enum dma_data_direction dma_dir;
 
+	// deferred dma mapping, run on qvio_queue.map_wq
+	struct work_struct map_work;
+	struct completion map_done;
+	int map_err;
+
 	struct xdma_io_cb io_cb;
+
+	// sub-frame slice transfer
+	int slices_req;
+	int slices_num;
+	atomic_t slices_pending;
+	int slices_err;
+	struct qvio_queue_slice slices[QVIO_MAX_SLICES];
+
+	// vb.sequence taken already, at the first slice
+	bool sequenced;
+
+	// frames dropped by decimation ahead of this buffer
+	struct xdma_io_cb skip_cbs[QVIO_MAX_DECIMATE - 1];
 };
 
 void qvio_queue_init(struct qvio_queue* self) {
 	mutex_init(&self->queue_mutex);
+	spin_lock_init(&self->sequence_lock);
 	INIT_LIST_HEAD(&self->buffers);
 	mutex_init(&self->buffers_mutex);
+
+	spin_lock_init(&self->posted_lock);
+	INIT_LIST_HEAD(&self->posted);
+	self->deadline_fallback = deadline_fallback;
+	self->frame_clock = frame_clock;
+	INIT_LIST_HEAD(&self->clock_ready);
+	self->deadline_interval = ns_to_ktime(NSEC_PER_SEC / QVIO_FRAME_RATE);
+#if KERNEL_VERSION(6, 15, 0) <= LINUX_VERSION_CODE
+	hrtimer_setup(&self->deadline_timer, __deadline_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+#else
+	hrtimer_init(&self->deadline_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	self->deadline_timer.function = __deadline_timer;
+#endif
+	INIT_WORK(&self->deadline_work, __deadline_work);
+	mutex_init(&self->fallback_mutex);
+	self->offline = false;
+	self->watchdog_frames = watchdog_frames;
+	self->watchdog_enable = false;
+	self->watchdog_timeout = 0;
+	atomic_set(&self->watchdog_inflight, 0);
+	INIT_DELAYED_WORK(&self->watchdog_work, __watchdog_work);
 }
 
 static int __queue_setup(struct vb2_queue *queue,
@@ -56,6 +149,7 @@ static int __queue_setup(struct vb2_queue *queue,
 		*num_planes = 1;
 		switch(self->current_format.fmt.pix.pixelformat) {
 		case V4L2_PIX_FMT_YUYV:
+		case V4L2_PIX_FMT_UYVY:
 			sizes[0] = ALIGN(self->current_format.fmt.pix.width * 2, self->halign) *
 				ALIGN(self->current_format.fmt.pix.height, self->valign);
 			alloc_devs[0] = video->qdev->dev;
@@ -73,6 +167,24 @@ static int __queue_setup(struct vb2_queue *queue,
 			alloc_devs[0] = video->qdev->dev;
 			break;
 
+		case V4L2_PIX_FMT_NV16:
+			sizes[0] = ALIGN(self->current_format.fmt.pix.width, self->halign) *
+				ALIGN(self->current_format.fmt.pix.height, self->valign) * 2;
+			alloc_devs[0] = video->qdev->dev;
+			break;
+
+		case V4L2_PIX_FMT_P010:
+			sizes[0] = ALIGN(self->current_format.fmt.pix.width * 2, self->halign) *
+				ALIGN(self->current_format.fmt.pix.height, self->valign) * 3 / 2;
+			alloc_devs[0] = video->qdev->dev;
+			break;
+
+		case QVIO_PIX_FMT_V210:
+			sizes[0] = ALIGN(QVIO_V210_STRIDE(self->current_format.fmt.pix.width), self->halign) *
+				ALIGN(self->current_format.fmt.pix.height, self->valign);
+			alloc_devs[0] = video->qdev->dev;
+			break;
+
 		default:
 			pr_err("invalid value, self->current_format.fmt.pix.pixelformat=%d", (int)self->current_format.fmt.pix.pixelformat);
 			err = -EINVAL;
@@ -85,6 +197,7 @@ static int __queue_setup(struct vb2_queue *queue,
 	case V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE:
 		switch(self->current_format.fmt.pix_mp.pixelformat) {
 		case V4L2_PIX_FMT_YUYV:
+		case V4L2_PIX_FMT_UYVY:
 			*num_planes = 1;
 			sizes[0] = ALIGN(self->current_format.fmt.pix_mp.width * 2, self->halign) *
 				ALIGN(self->current_format.fmt.pix_mp.height, self->valign);
@@ -108,6 +221,31 @@ static int __queue_setup(struct vb2_queue *queue,
 			alloc_devs[0] = video->qdev->dev;
 			break;
 
+		case V4L2_PIX_FMT_NV16:
+			*num_planes = 2;
+			sizes[0] = ALIGN(self->current_format.fmt.pix_mp.width, self->halign) *
+				ALIGN(self->current_format.fmt.pix_mp.height, self->valign);
+			sizes[1] = sizes[0];
+			alloc_devs[0] = video->qdev->dev;
+			alloc_devs[1] = video->qdev->dev;
+			break;
+
+		case V4L2_PIX_FMT_P010:
+			*num_planes = 2;
+			sizes[0] = ALIGN(self->current_format.fmt.pix_mp.width * 2, self->halign) *
+				ALIGN(self->current_format.fmt.pix_mp.height, self->valign);
+			sizes[1] = sizes[0] / 2;
+			alloc_devs[0] = video->qdev->dev;
+			alloc_devs[1] = video->qdev->dev;
+			break;
+
+		case QVIO_PIX_FMT_V210:
+			*num_planes = 1;
+			sizes[0] = ALIGN(QVIO_V210_STRIDE(self->current_format.fmt.pix_mp.width), self->halign) *
+				ALIGN(self->current_format.fmt.pix_mp.height, self->valign);
+			alloc_devs[0] = video->qdev->dev;
+			break;
+
 		default:
 			pr_err("invalid value, self->current_format.fmt.pix_mp.pixelformat=%d", (int)self->current_format.fmt.pix_mp.pixelformat);
 			err = -EINVAL;
@@ -137,7 +275,7 @@ static int vmalloc_dma_map_sg(struct device* dev, void* vaddr, int size, struct
 	struct scatterlist *sg;
 	int i, page_size;
 
-#if 1 // DEBUG
+#if 0 // DEBUG
 	pr_info("-----vaddr=%p size=%d num_pages=%d\n", vaddr, size, num_pages);
 #endif
 
@@ -185,7 +323,7 @@ err0:
 	return err;
 }
 
-static void sgt_dump(struct sg_table *sgt)
+static void __maybe_unused sgt_dump(struct sg_table *sgt)
 {
 	int i;
 	struct scatterlist *sg = sgt->sgl;
@@ -205,6 +343,655 @@ static void sgt_dump(struct sg_table *sgt)
 	}
 }
 
+// a buffer handed back while STREAMON is failing goes to vb2 as queued, not as an error
+static enum vb2_buffer_state __buf_error_state(struct qvio_queue* self) {
+	return vb2_is_streaming(&self->queue) ? VB2_BUF_STATE_ERROR : VB2_BUF_STATE_QUEUED;
+}
+
+// the frame's sequence, taken once, FRAME_SYNC and the buffer carry the same one,
+// elapsed is how long ago the frame started
+static u32 __buf_sequence(struct qvio_queue* self, struct qvio_queue_buffer* buf, u64 elapsed) {
+	struct qvio_video* video = container_of(self, struct qvio_video, queue);
+	struct qvio_group* group = &video->qdev->group;
+	unsigned long flags;
+
+	spin_lock_irqsave(&self->sequence_lock, flags);
+	if(! buf->sequenced) {
+		// grouped channels number by source frame, from when the frame started,
+		// a member that dropped a frame does not shift its numbering against the others,
+		// with a start-of-frame line the frame is the one its interrupt counted
+		if(qvio_group_has(group, video->channel))
+			buf->vb.sequence = qvio_group_sequence(group, ktime_get_ns() - elapsed, frame_sync_irq < 0);
+		else if(frame_sync_irq >= 0)
+			buf->vb.sequence = qvio_sof_frame(&self->sof, ktime_get_ns() - elapsed, false);
+		else
+			buf->vb.sequence = self->sequence++;
+
+		buf->sequenced = true;
+	}
+	spin_unlock_irqrestore(&self->sequence_lock, flags);
+
+	return buf->vb.sequence;
+}
+
+static void __buf_stamp(struct qvio_queue* self, struct qvio_queue_buffer* buf) {
+	struct qvio_video* video = container_of(self, struct qvio_video, queue);
+	struct qvio_group* group = &video->qdev->group;
+	u64 timestamp = ktime_get_ns();
+
+	buf->vb.field = V4L2_FIELD_NONE;
+	__buf_sequence(self, buf, self->frame_interval);
+	buf->sequenced = false;
+
+	// and the first timestamp of each frame
+	if(qvio_group_has(group, video->channel))
+		timestamp = qvio_group_timestamp(group, buf->vb.sequence, timestamp);
+
+	buf->vb.vb2_buf.timestamp = timestamp;
+}
+
+// black in the negotiated format, anything else is zeroed
+static void __fallback_slate(struct qvio_queue* self) {
+	u8* p = self->fallback_frame;
+	u16* p16 = self->fallback_frame;
+	unsigned long size = self->fallback_size;
+	unsigned long luma, i;
+	int width = self->current_format.fmt.pix.width;
+	int height = self->current_format.fmt.pix.height;
+
+	memset(p, 0, size);
+
+	if(self->current_format.type != V4L2_BUF_TYPE_VIDEO_CAPTURE &&
+		self->current_format.type != V4L2_BUF_TYPE_VIDEO_OUTPUT)
+		return;
+
+	switch(self->current_format.fmt.pix.pixelformat) {
+	case V4L2_PIX_FMT_YUYV:
+		for(i = 0;i + 1 < size;i += 2) {
+			p[i] = 0x10;
+			p[i + 1] = 0x80;
+		}
+		break;
+
+	case V4L2_PIX_FMT_UYVY:
+		for(i = 0;i + 1 < size;i += 2) {
+			p[i] = 0x80;
+			p[i + 1] = 0x10;
+		}
+		break;
+
+	case V4L2_PIX_FMT_NV12:
+	case V4L2_PIX_FMT_NV16:
+		luma = min_t(unsigned long, size, ALIGN(width, self->halign) * ALIGN(height, self->valign));
+		memset(p, 0x10, luma);
+		memset(p + luma, 0x80, size - luma);
+		break;
+
+	case V4L2_PIX_FMT_P010:
+		// 10 bits msb aligned, 64 and 512
+		luma = min_t(unsigned long, size, ALIGN(width * 2, self->halign) * ALIGN(height, self->valign));
+		for(i = 0;i < size / 2;i++)
+			p16[i] = cpu_to_le16(i < luma / 2 ? 0x1000 : 0x8000);
+		break;
+
+	default:
+		break;
+	}
+}
+
+static void* __dmabuf_vmap(struct dma_buf* dmabuf) {
+#if KERNEL_VERSION(5, 11, 0) <= LINUX_VERSION_CODE
+	int err;
+#if KERNEL_VERSION(5, 18, 0) <= LINUX_VERSION_CODE
+	struct iosys_map map;
+#else
+	struct dma_buf_map map;
+#endif
+
+#if KERNEL_VERSION(6, 2, 0) <= LINUX_VERSION_CODE
+	err = dma_buf_vmap_unlocked(dmabuf, &map);
+#else
+	err = dma_buf_vmap(dmabuf, &map);
+#endif
+	if(err) {
+		pr_err("dma_buf_vmap() failed, err=%d\n", err);
+		return NULL;
+	}
+
+	// plain memcpy only
+	if(map.is_iomem) {
+		pr_err("unexpected value, map.is_iomem=%d\n", (int)map.is_iomem);
+#if KERNEL_VERSION(6, 2, 0) <= LINUX_VERSION_CODE
+		dma_buf_vunmap_unlocked(dmabuf, &map);
+#else
+		dma_buf_vunmap(dmabuf, &map);
+#endif
+		return NULL;
+	}
+
+	return map.vaddr;
+#else
+	void* vaddr = dma_buf_vmap(dmabuf);
+
+	if(! vaddr)
+		pr_err("dma_buf_vmap() failed\n");
+
+	return vaddr;
+#endif
+}
+
+static void __dmabuf_vunmap(struct dma_buf* dmabuf, void* vaddr) {
+#if KERNEL_VERSION(5, 18, 0) <= LINUX_VERSION_CODE
+	struct iosys_map map = IOSYS_MAP_INIT_VADDR(vaddr);
+#elif KERNEL_VERSION(5, 11, 0) <= LINUX_VERSION_CODE
+	struct dma_buf_map map = DMA_BUF_MAP_INIT_VADDR(vaddr);
+#endif
+
+#if KERNEL_VERSION(6, 2, 0) <= LINUX_VERSION_CODE
+	dma_buf_vunmap_unlocked(dmabuf, &map);
+#elif KERNEL_VERSION(5, 11, 0) <= LINUX_VERSION_CODE
+	dma_buf_vunmap(dmabuf, &map);
+#else
+	dma_buf_vunmap(dmabuf, vaddr);
+#endif
+}
+
+static void __buf_fallback_copy(struct qvio_queue* self, struct qvio_queue_buffer* buf, bool save) {
+	struct vb2_buffer* buffer = &buf->vb.vb2_buf;
+	enum dma_data_direction dir = save ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
+	struct dma_buf* dmabuf;
+	u8* frame;
+	u8* base = NULL;
+	void* vaddr;
+	unsigned long offset, size;
+	unsigned int p;
+
+	mutex_lock(&self->fallback_mutex);
+	frame = self->fallback_frame;
+
+	// an adopted dma-buf is what the application maps, not vb2's plane behind it,
+	// set at BUF_INIT and dropped at buf_cleanup, neither while streaming
+	dmabuf = READ_ONCE(buf->dmabuf);
+	if(frame && dmabuf) {
+		base = __dmabuf_vmap(dmabuf);
+		if(! base) {
+			mutex_unlock(&self->fallback_mutex);
+			return;
+		}
+
+		dma_buf_begin_cpu_access(dmabuf, dir);
+	}
+
+	for(p = 0, offset = 0;frame && p < buffer->num_planes && offset < self->fallback_size;p++) {
+		if(base)
+			vaddr = (p < 4) ? base + buf->buf_init.offset[p] : NULL;
+		else
+			vaddr = vb2_plane_vaddr(buffer, p);
+		size = min_t(unsigned long, vb2_plane_size(buffer, p), self->fallback_size - offset);
+
+		if(vaddr) {
+			if(save)
+				memcpy(frame + offset, vaddr, size);
+			else
+				memcpy(vaddr, frame + offset, size);
+		}
+
+		offset += size;
+	}
+
+	if(base) {
+		dma_buf_end_cpu_access(dmabuf, dir);
+		__dmabuf_vunmap(dmabuf, base);
+	}
+	mutex_unlock(&self->fallback_mutex);
+}
+
+// user-job devices: the daemon fills the buffer and returns BUF_DONE asynchronously
+static void __buf_user_job_done(void* user, struct qvio_user_job_done* user_job_done) {
+	struct qvio_queue_buffer* buf = user;
+	struct qvio_queue* self = vb2_get_drv_priv(buf->vb.vb2_buf.vb2_queue);
+	bool good = user_job_done && user_job_done->u.buf_done.flags >= 0;
+	unsigned long flags;
+	bool claimed;
+
+	// off the posted list, unless the deadline completed it already
+	spin_lock_irqsave(&self->posted_lock, flags);
+	claimed = list_empty(&buf->list_posted);
+	list_del_init(&buf->list_posted);
+	if(! claimed && good && self->deadline_credit < 2)
+		self->deadline_credit++;
+	spin_unlock_irqrestore(&self->posted_lock, flags);
+
+	if(claimed)
+		return;
+
+	if(! good) {
+		vb2_buffer_done(&buf->vb.vb2_buf, __buf_error_state(self));
+		return;
+	}
+
+	// output, the daemon has consumed the frame, the timestamp stays the application's
+	if(V4L2_TYPE_IS_OUTPUT(buf->vb.vb2_buf.type)) {
+		buf->vb.sequence = self->sequence++;
+		vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_DONE);
+		return;
+	}
+
+	if(self->deadline_fallback == QVIO_DEADLINE_REPEAT)
+		__buf_fallback_copy(self, buf, true);
+
+	// paced, held for the next frame boundary
+	spin_lock_irqsave(&self->posted_lock, flags);
+	if(self->clock_enable) {
+		list_add_tail(&buf->list_posted, &self->clock_ready);
+		spin_unlock_irqrestore(&self->posted_lock, flags);
+		return;
+	}
+	spin_unlock_irqrestore(&self->posted_lock, flags);
+
+	__buf_stamp(self, buf);
+
+	vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_DONE);
+}
+
+static int __buf_user_job_post(struct qvio_queue* self, struct qvio_queue_buffer* buf) {
+	int err;
+	struct qvio_video* video = container_of(self, struct qvio_video, queue);
+	unsigned long flags;
+
+	// before posting, the done may come back right away
+	spin_lock_irqsave(&self->posted_lock, flags);
+	list_add_tail(&buf->list_posted, &self->posted);
+	spin_unlock_irqrestore(&self->posted_lock, flags);
+
+	err = qvio_user_job_buf_done(&video->user_job_ctrl, &buf->vb.vb2_buf, buf, __buf_user_job_done);
+	if(err) {
+		// a stalled daemon with its ring full, the deadline completes the frame like any other miss
+		if(self->deadline_fallback != QVIO_DEADLINE_OFF && ! V4L2_TYPE_IS_OUTPUT(buf->vb.vb2_buf.type)) {
+			pr_warn_ratelimited("not posted, index=%d err=%d\n", buf->vb.vb2_buf.index, err);
+			return 0;
+		}
+
+		spin_lock_irqsave(&self->posted_lock, flags);
+		list_del_init(&buf->list_posted);
+		spin_unlock_irqrestore(&self->posted_lock, flags);
+	}
+
+	return err;
+}
+
+// exact timeperframe, the sub-nanosecond remainder is carried so the clock never drifts
+static void __clock_advance(struct qvio_queue* self) {
+	self->clock_next = ktime_add_ns(self->clock_next, self->clock_step);
+	self->clock_acc += self->clock_rem;
+	if(self->clock_acc >= self->clock_den) {
+		self->clock_acc -= self->clock_den;
+		self->clock_next = ktime_add_ns(self->clock_next, 1);
+	}
+}
+
+static enum hrtimer_restart __deadline_timer(struct hrtimer* timer) {
+	struct qvio_queue* self = container_of(timer, struct qvio_queue, deadline_timer);
+	ktime_t now;
+
+	// not on map_wq, a REQBUFS mapping burst must not hold up the tick
+	if(! self->clock_enable) {
+		queue_work(system_highpri_wq, &self->deadline_work);
+		hrtimer_forward_now(timer, self->deadline_interval);
+
+		return HRTIMER_RESTART;
+	}
+
+	spin_lock(&self->posted_lock);
+	self->clock_boundary = self->clock_next;
+	self->clock_ticks++;
+	self->clock_due++;
+	spin_unlock(&self->posted_lock);
+
+	queue_work(system_highpri_wq, &self->deadline_work);
+
+	// boundaries passed already are dropped, not bunched up
+	now = ktime_get();
+	__clock_advance(self);
+	while(ktime_before(self->clock_next, now)) {
+		__clock_advance(self);
+		self->clock_overruns++;
+	}
+	hrtimer_set_expires(timer, self->clock_next);
+
+	return HRTIMER_RESTART;
+}
+
+static void __clock_post_next(struct qvio_queue* self) {
+	int err;
+	struct qvio_queue_buffer* buf = NULL;
+
+	mutex_lock(&self->buffers_mutex);
+	if(! list_empty(&self->buffers)) {
+		buf = list_first_entry(&self->buffers, struct qvio_queue_buffer, list_ready);
+		list_del(&buf->list_ready);
+	}
+	mutex_unlock(&self->buffers_mutex);
+
+	if(! buf)
+		return;
+
+	err = __buf_user_job_post(self, buf);
+	if(err) {
+		pr_err("__buf_user_job_post() failed, err=%d\n", err);
+		vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_ERROR);
+	}
+}
+
+// a frame boundary, complete what the daemon answered and hand it the next buffer
+static void __clock_tick(struct qvio_queue* self) {
+	struct qvio_video* video = container_of(self, struct qvio_video, queue);
+	struct qvio_queue_buffer* buf;
+	unsigned long flags;
+	ktime_t boundary;
+	s64 jitter;
+	bool fallback;
+	u32 due;
+
+	spin_lock_irqsave(&self->posted_lock, flags);
+	due = self->clock_due;
+	self->clock_due = 0;
+	boundary = self->clock_boundary;
+	spin_unlock_irqrestore(&self->posted_lock, flags);
+
+	while(due--) {
+		buf = NULL;
+		fallback = false;
+
+		spin_lock_irqsave(&self->posted_lock, flags);
+		if(! list_empty(&self->clock_ready)) {
+			buf = list_first_entry(&self->clock_ready, struct qvio_queue_buffer, list_posted);
+			list_del_init(&buf->list_posted);
+		} else if(self->deadline_fallback != QVIO_DEADLINE_OFF && ! list_empty(&self->posted)) {
+			buf = list_first_entry(&self->posted, struct qvio_queue_buffer, list_posted);
+			list_del_init(&buf->list_posted);
+			self->deadline_misses++;
+			fallback = true;
+		}
+		spin_unlock_irqrestore(&self->posted_lock, flags);
+
+		if(! buf) {
+			self->clock_underruns++;
+			continue;
+		}
+
+		if(fallback) {
+			qvio_user_job_abandon(&video->user_job_ctrl, buf);
+			__buf_fallback_copy(self, buf, false);
+		}
+
+		__buf_stamp(self, buf);
+		buf->vb.vb2_buf.timestamp = ktime_to_ns(boundary);
+
+		vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_DONE);
+
+		jitter = ktime_to_ns(ktime_sub(ktime_get(), boundary));
+		self->clock_frames++;
+		self->clock_jitter_sum += jitter;
+		if(jitter > self->clock_jitter_max)
+			self->clock_jitter_max = (u32)min_t(s64, jitter, U32_MAX);
+		self->clock_drift = (s32)clamp_t(s64, jitter, S32_MIN, S32_MAX);
+	}
+
+	__clock_post_next(self);
+}
+
+// one frame interval has passed, the daemon owes a frame
+static void __deadline_work(struct work_struct* work) {
+	struct qvio_queue* self = container_of(work, struct qvio_queue, deadline_work);
+	struct qvio_video* video = container_of(self, struct qvio_video, queue);
+	struct qvio_queue_buffer* buf;
+	unsigned long flags;
+
+	// the daemon's answers count before the boundary, it does not kick for them
+	qvio_user_job_reap(&video->user_job_ctrl);
+
+	if(self->clock_enable) {
+		__clock_tick(self);
+		return;
+	}
+
+	spin_lock_irqsave(&self->posted_lock, flags);
+	if(self->deadline_credit > 0 || list_empty(&self->posted)) {
+		// in time, or the application has nothing queued
+		if(self->deadline_credit > 0)
+			self->deadline_credit--;
+		spin_unlock_irqrestore(&self->posted_lock, flags);
+		return;
+	}
+
+	buf = list_first_entry(&self->posted, struct qvio_queue_buffer, list_posted);
+	list_del_init(&buf->list_posted);
+	self->deadline_misses++;
+	spin_unlock_irqrestore(&self->posted_lock, flags);
+
+	// the slot is released, the daemon's late done is dropped
+	qvio_user_job_abandon(&video->user_job_ctrl, buf);
+
+	__buf_fallback_copy(self, buf, false);
+	__buf_stamp(self, buf);
+
+	vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_DONE);
+
+	pr_warn_ratelimited("deadline missed, index=%d misses=%u\n",
+		buf->vb.vb2_buf.index, self->deadline_misses);
+}
+
+static int __fallback_alloc(struct qvio_queue* self) {
+	struct vb2_buffer* buffer;
+	void* fallback_frame;
+	unsigned long fallback_size;
+	unsigned int p;
+
+	fallback_size = 0;
+	buffer = vb2_get_buffer(&self->queue, 0);
+	for(p = 0;buffer && p < buffer->num_planes;p++)
+		fallback_size += vb2_plane_size(buffer, p);
+
+	fallback_frame = vmalloc(fallback_size);
+	if(! fallback_frame) {
+		pr_err("vmalloc() failed, fallback_size=%lu\n", fallback_size);
+		return -ENOMEM;
+	}
+
+	mutex_lock(&self->fallback_mutex);
+	self->fallback_frame = fallback_frame;
+	self->fallback_size = fallback_size;
+	__fallback_slate(self);
+	mutex_unlock(&self->fallback_mutex);
+
+	return 0;
+}
+
+static int __deadline_start(struct qvio_queue* self) {
+	int err;
+	struct qvio_video* video = container_of(self, struct qvio_video, queue);
+	struct v4l2_fract* timeperframe = &video->current_parm.parm.capture.timeperframe;
+
+	if(timeperframe->numerator && timeperframe->denominator) {
+		self->clock_den = timeperframe->denominator;
+		self->clock_step = div_u64_rem((u64)timeperframe->numerator * NSEC_PER_SEC, self->clock_den, &self->clock_rem);
+	} else {
+		self->clock_den = QVIO_FRAME_RATE;
+		self->clock_step = div_u64_rem(NSEC_PER_SEC, self->clock_den, &self->clock_rem);
+	}
+	self->clock_acc = 0;
+
+	self->deadline_credit = 1; // the first frame may take a whole interval
+	self->deadline_misses = 0;
+	self->deadline_interval = ns_to_ktime(self->clock_step);
+
+	// output frames are consumed at the daemon's pace
+	if(V4L2_TYPE_IS_OUTPUT(self->queue.type))
+		return 0;
+
+	self->clock_enable = self->frame_clock;
+	self->clock_due = 0;
+	self->clock_ticks = 0;
+	self->clock_frames = 0;
+	self->clock_underruns = 0;
+	self->clock_overruns = 0;
+	self->clock_jitter_sum = 0;
+	self->clock_jitter_max = 0;
+	self->clock_drift = 0;
+
+	if(self->deadline_fallback != QVIO_DEADLINE_OFF) {
+		err = __fallback_alloc(self);
+		if(err) {
+			pr_err("__fallback_alloc() failed, err=%d\n", err);
+			return err;
+		}
+	}
+
+	if(self->deadline_fallback == QVIO_DEADLINE_OFF && ! self->clock_enable)
+		return 0;
+
+	pr_info("fallback=%d clock=%d interval=%lluns+%u/%u\n", self->deadline_fallback, (int)self->clock_enable,
+		self->clock_step, self->clock_rem, self->clock_den);
+
+	// the first boundary completes the buffer posted at STREAMON
+	self->clock_next = ktime_get();
+	__clock_advance(self);
+	hrtimer_start(&self->deadline_timer, self->clock_next, HRTIMER_MODE_ABS);
+
+	return 0;
+}
+
+static void __deadline_stop(struct qvio_queue* self) {
+	struct qvio_queue_buffer* buf;
+	struct qvio_queue_buffer* node;
+	unsigned long flags;
+	LIST_HEAD(ready);
+
+	hrtimer_cancel(&self->deadline_timer);
+	cancel_work_sync(&self->deadline_work);
+
+	// answered frames not due yet
+	spin_lock_irqsave(&self->posted_lock, flags);
+	self->clock_enable = false;
+	list_splice_init(&self->clock_ready, &ready);
+	spin_unlock_irqrestore(&self->posted_lock, flags);
+
+	list_for_each_entry_safe(buf, node, &ready, list_posted) {
+		list_del_init(&buf->list_posted);
+		vb2_buffer_done(&buf->vb.vb2_buf, __buf_error_state(self));
+	}
+
+	mutex_lock(&self->fallback_mutex);
+	vfree(self->fallback_frame);
+	self->fallback_frame = NULL;
+	self->fallback_size = 0;
+	mutex_unlock(&self->fallback_mutex);
+}
+
+// counts the buffers in flight from the first submit, the timer waits for __watchdog_start()
+static void __watchdog_prepare(struct qvio_queue* self) {
+	struct qvio_video* video = container_of(self, struct qvio_video, queue);
+	struct v4l2_fract* timeperframe = &video->current_parm.parm.capture.timeperframe;
+	u64 interval;
+
+	self->watchdog_enable = false;
+	self->watchdog_timeout = 0;
+	atomic_set(&self->watchdog_inflight, 0);
+	self->watchdog_recoveries = 0;
+	self->watchdog_failures = 0;
+
+	// the engine path of capture nodes only
+	if(self->watchdog_frames <= 0 || ! video->qdev->xdev || video->user_job_ctrl.enable ||
+		V4L2_TYPE_IS_OUTPUT(self->queue.type))
+		return;
+
+	if(timeperframe->numerator && timeperframe->denominator)
+		interval = div_u64((u64)timeperframe->numerator * NSEC_PER_SEC, timeperframe->denominator);
+	else
+		interval = NSEC_PER_SEC / QVIO_FRAME_RATE;
+	self->watchdog_timeout = nsecs_to_jiffies(interval * self->watchdog_frames) + 1;
+
+	pr_info("channel=%d frames=%d timeout=%ums\n", video->channel, self->watchdog_frames,
+		jiffies_to_msecs(self->watchdog_timeout));
+}
+
+// the channel is live, a grouped one on the streamon write of the last member
+static void __watchdog_start(struct qvio_queue* self) {
+	if(! self->watchdog_timeout)
+		return;
+
+	WRITE_ONCE(self->watchdog_enable, true);
+	smp_mb();
+
+	if(atomic_read(&self->watchdog_inflight))
+		mod_delayed_work(system_wq, &self->watchdog_work, self->watchdog_timeout);
+}
+
+static void __watchdog_stop(struct qvio_queue* self) {
+	WRITE_ONCE(self->watchdog_enable, false);
+	cancel_delayed_work_sync(&self->watchdog_work);
+}
+
+// a buffer handed to the engine, the timeout runs from here if nothing else is in flight
+static void __watchdog_arm(struct qvio_queue* self) {
+	if(! self->watchdog_timeout)
+		return;
+
+	if(atomic_inc_return(&self->watchdog_inflight) == 1 && READ_ONCE(self->watchdog_enable))
+		mod_delayed_work(system_wq, &self->watchdog_work, self->watchdog_timeout);
+}
+
+// a transfer completed, the next one in flight gets a whole timeout, any context
+static void __watchdog_kick(struct qvio_queue* self, bool buf_done) {
+	if(! self->watchdog_timeout)
+		return;
+
+	if(buf_done)
+		atomic_dec_if_positive(&self->watchdog_inflight);
+
+	if(READ_ONCE(self->watchdog_enable))
+		mod_delayed_work(system_wq, &self->watchdog_work, self->watchdog_timeout);
+}
+
+static void __watchdog_work(struct work_struct* work) {
+	int err;
+	struct qvio_queue* self = container_of(to_delayed_work(work), struct qvio_queue, watchdog_work);
+	struct qvio_video* video = container_of(self, struct qvio_video, queue);
+
+	if(! READ_ONCE(self->watchdog_enable) || ! atomic_read(&self->watchdog_inflight))
+		return;
+
+	// started by the last member, this one may be stopping already
+	if(qvio_group_has(&video->qdev->group, video->channel) &&
+		! qvio_group_armed(&video->qdev->group, video->channel))
+		return;
+
+	pr_warn("channel=%d, no completion in %ums, inflight=%d, resetting the engine\n", video->channel,
+		jiffies_to_msecs(self->watchdog_timeout), atomic_read(&self->watchdog_inflight));
+
+	// the transfers in flight come back as errors, the buffers held meanwhile are resubmitted
+	err = qvio_device_engine_reset(video->qdev, video->channel);
+	if(err) {
+		pr_err("qvio_device_engine_reset() failed, err=%d\n", err);
+		self->watchdog_failures++;
+	} else
+		self->watchdog_recoveries++;
+
+	self->watchdog_last = ktime_get_ns();
+}
+
+// the event timestamp is taken here, raise it as close to the frame start as possible
+static void __frame_sync(struct qvio_queue* self, u32 sequence) {
+	struct qvio_video* video = container_of(self, struct qvio_video, queue);
+	struct v4l2_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.type = V4L2_EVENT_FRAME_SYNC;
+	event.u.frame_sync.frame_sequence = sequence;
+	v4l2_event_queue(video->vdev, &event);
+}
+
 static void __io_done(unsigned long  cb_hndl, int err) {
 	struct xdma_io_cb *cb = (struct xdma_io_cb *)cb_hndl;
 	struct vb2_buffer *buffer = cb->private;
@@ -215,7 +1002,7 @@ static void __io_done(unsigned long  cb_hndl, int err) {
 	struct xdma_dev *xdev = video->qdev->xdev;
 	ssize_t size = 0;
 
-#if 1 // DEBUG
+#if 0 // DEBUG
 	pr_info("param: %p %p %d %p, err=%d\n", self, vbuf, vbuf->vb2_buf.index, buf, err);
 #endif
 
@@ -225,20 +1012,28 @@ static void __io_done(unsigned long  cb_hndl, int err) {
 		goto err0;
 	}
 
+#if 0 // DEBUG
 	pr_info("++++\n");
+#endif
 	size = xdma_xfer_completion((void *)cb, xdev,
 		video->channel, cb->write, cb->ep_addr, &buf->sgt, true, 1000);
 	if((int)size < 0) {
 		err = (int)size;
 		pr_warn("xdma_xfer_completion() failed, err=%d", err);
 
+		// failed or drained by an engine offline
+		__watchdog_kick(self, true);
+		vb2_buffer_done(&buf->vb.vb2_buf, __buf_error_state(self));
+
 		goto err0;
 	}
+#if 0 // DEBUG
 	pr_info("----\n");
+#endif
 
-	buf->vb.vb2_buf.timestamp = ktime_get_ns();
-	buf->vb.field = V4L2_FIELD_NONE;
-	buf->vb.sequence = self->sequence++;
+	__watchdog_kick(self, true);
+
+	__buf_stamp(self, buf);
 
 	vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_DONE);
 
@@ -281,38 +1076,284 @@ err0:
 	return;
 }
 
-static int __buf_init(struct vb2_buffer *buffer) {
+// the slice's rows arrived over its share of the frame interval
+static u64 __slice_elapsed(struct qvio_queue* self, struct qvio_queue_buffer* buf, struct qvio_queue_slice* slice) {
+	return div_u64(self->frame_interval * (slice->index + 1), max(buf->slices_num, 1));
+}
+
+static void __slice_io_done(unsigned long  cb_hndl, int err) {
+	struct xdma_io_cb *cb = (struct xdma_io_cb *)cb_hndl;
+	struct qvio_queue_slice* slice = cb->private;
+	struct qvio_queue_buffer* buf = slice->buf;
+	struct vb2_buffer *buffer = &buf->vb.vb2_buf;
+	struct qvio_queue* self = vb2_get_drv_priv(buffer->vb2_queue);
+	struct qvio_video* video = container_of(self, struct qvio_video, queue);
+	struct xdma_dev *xdev = video->qdev->xdev;
+	struct v4l2_event event;
+	struct qvio_event_slice* event_slice = (struct qvio_event_slice*)event.u.data;
+	struct scatterlist *sg;
+	ssize_t size;
+	int i;
+
+	if (err) {
+		pr_err("err=%d\n", err);
+		buf->slices_err = err;
+	} else {
+		size = xdma_xfer_completion((void *)cb, xdev,
+			video->channel, cb->write, cb->ep_addr, &slice->sgt, true, 1000);
+		if((int)size < 0) {
+			err = (int)size;
+			pr_warn("xdma_xfer_completion() failed, err=%d", err);
+			buf->slices_err = err;
+		}
+	}
+
+	// the first rows of the frame have landed, the frame's sequence is taken here
+	if (! err && slice->index == 0 && buf->slices_num > 1 && frame_sync_irq < 0)
+		__frame_sync(self, __buf_sequence(self, buf, __slice_elapsed(self, buf, slice)));
+
+	if (! err) {
+		// only this slice is handed to the cpu, the rest is still in flight
+		for_each_sg(slice->sgt.sgl, sg, slice->sgt.nents, i) {
+			dma_sync_single_for_cpu(video->qdev->dev, sg_dma_address(sg),
+				sg_dma_len(sg), DMA_BIDIRECTIONAL);
+		}
+
+		memset(&event, 0, sizeof(event));
+		event.type = QVIO_EVENT_SLICE;
+		event_slice->index = buffer->index;
+		event_slice->sequence = __buf_sequence(self, buf, __slice_elapsed(self, buf, slice));
+		event_slice->slice = slice->index;
+		event_slice->slices = buf->slices_num;
+		event_slice->bytesused = slice->offset + slice->size;
+		event_slice->rows = (slice->offset + slice->size) / self->current_format.fmt.pix.bytesperline;
+		v4l2_event_queue(video->vdev, &event);
+	}
+
+	if(! atomic_dec_and_test(&buf->slices_pending)) {
+		__watchdog_kick(self, false);
+		return;
+	}
+
+	__watchdog_kick(self, true);
+
+	__buf_stamp(self, buf);
+
+	vb2_buffer_done(&buf->vb.vb2_buf, buf->slices_err ? __buf_error_state(self) : VB2_BUF_STATE_DONE);
+}
+
+static void __skip_io_done(unsigned long  cb_hndl, int err) {
+	struct xdma_io_cb *cb = (struct xdma_io_cb *)cb_hndl;
+	struct qvio_queue_buffer* buf = cb->private;
+	struct qvio_queue* self = vb2_get_drv_priv(buf->vb.vb2_buf.vb2_queue);
+	struct qvio_video* video = container_of(self, struct qvio_video, queue);
+	struct xdma_dev *xdev = video->qdev->xdev;
+	ssize_t size;
+
+	if (err) {
+		pr_err("err=%d\n", err);
+		return;
+	}
+
+	// nothing to sync or deliver, the frame is discarded
+	size = xdma_xfer_completion((void *)cb, xdev,
+		video->channel, cb->write, cb->ep_addr, &self->scratch_sgt, true, 1000);
+	if((int)size < 0) {
+		pr_warn("xdma_xfer_completion() failed, err=%d", (int)size);
+	}
+
+	__watchdog_kick(self, false);
+}
+
+static int __scratch_alloc(struct qvio_queue* self, int frame_size) {
+	int err;
+	struct qvio_video* video = container_of(self, struct qvio_video, queue);
+	struct scatterlist *sg;
+	int i, nents;
+
+	self->scratch_virt = dma_alloc_coherent(video->qdev->dev, QVIO_SCRATCH_SIZE, &self->scratch_dma, GFP_KERNEL);
+	if(! self->scratch_virt) {
+		pr_err("dma_alloc_coherent() failed\n");
+		err = -ENOMEM;
+		goto err0;
+	}
+
+	// dma-only sg_table, every entry points back to the same block
+	nents = DIV_ROUND_UP(frame_size, QVIO_SCRATCH_SIZE);
+	err = sg_alloc_table(&self->scratch_sgt, nents, GFP_KERNEL);
+	if (err) {
+		pr_err("sg_alloc_table() failed, err=%d\n", err);
+		goto err1;
+	}
+
+	for_each_sg(self->scratch_sgt.sgl, sg, nents, i) {
+		sg_dma_address(sg) = self->scratch_dma;
+		sg_dma_len(sg) = min(frame_size - i * QVIO_SCRATCH_SIZE, QVIO_SCRATCH_SIZE);
+	}
+
+	return 0;
+
+err1:
+	dma_free_coherent(video->qdev->dev, QVIO_SCRATCH_SIZE, self->scratch_virt, self->scratch_dma);
+	self->scratch_virt = NULL;
+err0:
+	return err;
+}
+
+static void __scratch_free(struct qvio_queue* self) {
+	struct qvio_video* video = container_of(self, struct qvio_video, queue);
+
+	if(! self->scratch_virt)
+		return;
+
+	sg_free_table(&self->scratch_sgt);
+	dma_free_coherent(video->qdev->dev, QVIO_SCRATCH_SIZE, self->scratch_virt, self->scratch_dma);
+	self->scratch_virt = NULL;
+}
+
+static void __buf_slices_free(struct qvio_queue_buffer* buf) {
+	int i;
+
+	for(i = 0;i < buf->slices_num;i++)
+		sg_free_table(&buf->slices[i].sgt);
+
+	buf->slices_num = 0;
+}
+
+// build a dma-only sg_table covering [offset, offset + size) of an already mapped sg_table
+static int __sgt_dma_slice(struct sg_table* src, int offset, int size, struct sg_table* dst) {
+	int err;
+	struct scatterlist *sg, *sg_dst;
+	int i, nents = 0;
+	int pos, start, end;
+
+	pos = 0;
+	for_each_sg(src->sgl, sg, src->nents, i) {
+		start = max(pos, offset);
+		end = min(pos + (int)sg_dma_len(sg), offset + size);
+		if(start < end)
+			nents++;
+		pos += sg_dma_len(sg);
+	}
+
+	err = sg_alloc_table(dst, nents, GFP_KERNEL);
+	if (err) {
+		pr_err("sg_alloc_table() failed, err=%d\n", err);
+		goto err0;
+	}
+
+	pos = 0;
+	sg_dst = dst->sgl;
+	for_each_sg(src->sgl, sg, src->nents, i) {
+		start = max(pos, offset);
+		end = min(pos + (int)sg_dma_len(sg), offset + size);
+		if(start < end) {
+			sg_dma_address(sg_dst) = sg_dma_address(sg) + (start - pos);
+			sg_dma_len(sg_dst) = end - start;
+			sg_dst = sg_next(sg_dst);
+		}
+		pos += sg_dma_len(sg);
+	}
+
+	return 0;
+
+err0:
+	return err;
+}
+
+static int __buf_slices_build(struct qvio_queue* self, struct qvio_queue_buffer* buf, int num) {
 	int err;
+	int i, bytesperline, rows, rows_per_slice, offset;
+
+	bytesperline = self->current_format.fmt.pix.bytesperline;
+	rows = self->current_format.fmt.pix.sizeimage / bytesperline;
+	rows_per_slice = DIV_ROUND_UP(rows, num);
+
+	__buf_slices_free(buf);
+
+	offset = 0;
+	for(i = 0;i < num && offset < rows * bytesperline;i++) {
+		struct qvio_queue_slice* slice = &buf->slices[i];
+
+		slice->buf = buf;
+		slice->index = i;
+		slice->offset = offset;
+		slice->rows = min(rows_per_slice, rows - offset / bytesperline);
+		slice->size = slice->rows * bytesperline;
+
+		err = __sgt_dma_slice(&buf->sgt, slice->offset, slice->size, &slice->sgt);
+		if(err) {
+			pr_err("__sgt_dma_slice() failed, err=%d\n", err);
+			goto err0;
+		}
+
+		memset(&slice->io_cb, 0, sizeof(struct xdma_io_cb));
+		slice->io_cb.ep_addr = 0;
+		slice->io_cb.write = false;
+		slice->io_cb.private = slice;
+		slice->io_cb.io_done = __slice_io_done;
+
+		buf->slices_num = i + 1;
+		offset += slice->size;
+	}
+
+	return 0;
+
+err0:
+	__buf_slices_free(buf);
+	return err;
+}
+
+static void __buf_map_work(struct work_struct *work) {
+	struct qvio_queue_buffer* buf = container_of(work, struct qvio_queue_buffer, map_work);
+	struct vb2_buffer *buffer = &buf->vb.vb2_buf;
 	struct qvio_queue* self = vb2_get_drv_priv(buffer->vb2_queue);
 	struct qvio_video* video = container_of(self, struct qvio_video, queue);
+	int err;
+
+	err = vmalloc_dma_map_sg(video->qdev->dev, vb2_plane_vaddr(buffer, 0),
+		vb2_plane_size(buffer, 0), &buf->sgt, DMA_BIDIRECTIONAL);
+	if(err) {
+		pr_err("vmalloc_dma_map_sg() failed, err=%d\n", err);
+	} else {
+		buf->dma_dir = DMA_BIDIRECTIONAL;
+	}
+
+#if 0 // DEBUG
+	sgt_dump(&buf->sgt);
+#endif
+
+	buf->map_err = err;
+	complete_all(&buf->map_done);
+}
+
+static int __buf_wait_mapped(struct qvio_queue_buffer* buf) {
+	wait_for_completion(&buf->map_done);
+
+	return buf->map_err;
+}
+
+static int __buf_init(struct vb2_buffer *buffer) {
+	int err;
+	int i;
+	struct qvio_queue* self = vb2_get_drv_priv(buffer->vb2_queue);
 	struct vb2_v4l2_buffer *vbuf = to_vb2_v4l2_buffer(buffer);
 	struct qvio_queue_buffer* buf = container_of(vbuf, struct qvio_queue_buffer, vb);
-	int plane_size;
-	void* vaddr;
 
-#if 1 // DEBUG
+#if 0 // DEBUG
 	pr_info("param: %p %p %d %p\n", self, vbuf, vbuf->vb2_buf.index, buf);
+	pr_info("plane_size=%d, vaddr=%p\n", (int)vb2_plane_size(buffer, 0), vb2_plane_vaddr(buffer, 0));
 #endif
 
-	plane_size = vb2_plane_size(buffer, 0);
-	vaddr = vb2_plane_vaddr(buffer, 0);
-
-	pr_info("plane_size=%d, vaddr=%p\n", (int)plane_size, vaddr);
-
 	switch(buffer->memory) {
 #if 1
 	case V4L2_MEMORY_MMAP:
+		INIT_LIST_HEAD(&buf->list_posted);
+		buf->dmabuf = NULL;
 		buf->dma_dir = DMA_NONE;
-		err = vmalloc_dma_map_sg(video->qdev->dev, vaddr, plane_size, &buf->sgt, DMA_BIDIRECTIONAL);
-		if(err) {
-			pr_err("vmalloc_dma_map_sg() failed, err=%d\n", err);
-			goto err0;
-		}
-		buf->dma_dir = DMA_BIDIRECTIONAL;
-
-#if 1 // DEBUG
-		sgt_dump(&buf->sgt);
-#endif
+		buf->map_err = 0;
+		init_completion(&buf->map_done);
+		INIT_WORK(&buf->map_work, __buf_map_work);
 
 		memset(&buf->io_cb, 0, sizeof(struct xdma_io_cb));
 		buf->io_cb.ep_addr = 0;
@@ -320,6 +1361,20 @@ static int __buf_init(struct vb2_buffer *buffer) {
 		buf->io_cb.private = buffer;
 		buf->io_cb.io_done = __io_done;
 
+		buf->slices_req = 0;
+		buf->slices_num = 0;
+
+		for(i = 0;i < QVIO_MAX_DECIMATE - 1;i++) {
+			memset(&buf->skip_cbs[i], 0, sizeof(struct xdma_io_cb));
+			buf->skip_cbs[i].ep_addr = 0;
+			buf->skip_cbs[i].write = false;
+			buf->skip_cbs[i].private = buf;
+			buf->skip_cbs[i].io_done = __skip_io_done;
+		}
+
+		// page walk + dma_map_sg run in parallel for all buffers,
+		// __buf_prepare() waits for this one only
+		queue_work(self->map_wq, &buf->map_work);
 		break;
 #endif
 
@@ -343,14 +1398,24 @@ static void __buf_cleanup(struct vb2_buffer *buffer) {
 	struct qvio_queue_buffer* buf = container_of(vbuf, struct qvio_queue_buffer, vb);
 	struct sg_table* sgt = &buf->sgt;
 
-#if 1 // DEBUG
+#if 0 // DEBUG
 	pr_info("param: %p %p %d %p\n", self, vbuf, vbuf->vb2_buf.index, buf);
 #endif
 
-	// TODO: user-job dma-buf detach
+	// vb2 holds mmap_lock while freeing
+	if(buf->dmabuf) {
+		dma_buf_put(buf->dmabuf);
+		buf->dmabuf = NULL;
+	}
+
+	if(__buf_wait_mapped(buf))
+		return;
+
+	__buf_slices_free(buf);
+	buf->slices_req = 0;
 
 #if 1
-#if 1 // DEBUG
+#if 0 // DEBUG
 	sgt_dump(sgt);
 #endif
 
@@ -371,17 +1436,30 @@ static int __buf_prepare(struct vb2_buffer *buffer) {
 	struct vb2_v4l2_buffer *vbuf = to_vb2_v4l2_buffer(buffer);
 	struct qvio_queue_buffer* buf = container_of(vbuf, struct qvio_queue_buffer, vb);
 	int plane_size;
+	unsigned long payload[VIDEO_MAX_PLANES];
+	unsigned int p;
 
 #if 0 // DEBUG
 	pr_info("param: %p %p %d %p\n", self, vbuf, vbuf->vb2_buf.index, buf);
 #endif
 
+	// output payloads come from the application, checked by vb2 already
+	for(p = 0;p < buffer->num_planes;p++)
+		payload[p] = vb2_get_plane_payload(buffer, p);
+
+	err = __buf_wait_mapped(buf);
+	if(err) {
+		pr_err("__buf_wait_mapped() failed, err=%d\n", err);
+		goto err0;
+	}
+
 	switch(self->current_format.type) {
 	case V4L2_BUF_TYPE_VIDEO_CAPTURE:
 	case V4L2_BUF_TYPE_VIDEO_OUTPUT:
 		plane_size = vb2_plane_size(buffer, 0);
 		switch(self->current_format.fmt.pix.pixelformat) {
 		case V4L2_PIX_FMT_YUYV:
+		case V4L2_PIX_FMT_UYVY:
 			if(plane_size < ALIGN(self->current_format.fmt.pix.width, self->halign) *
 					ALIGN(self->current_format.fmt.pix.height, self->valign) * 2) {
 				pr_err("unexpected value, plane_size=%d\n", plane_size);
@@ -411,6 +1489,36 @@ static int __buf_prepare(struct vb2_buffer *buffer) {
 			}
 			break;
 
+		case V4L2_PIX_FMT_NV16:
+			if(plane_size < ALIGN(self->current_format.fmt.pix.width, self->halign) *
+					ALIGN(self->current_format.fmt.pix.height, self->valign) * 2) {
+				pr_err("unexpected value, plane_size=%d\n", plane_size);
+
+				err = -EINVAL;
+				goto err0;
+			}
+			break;
+
+		case V4L2_PIX_FMT_P010:
+			if(plane_size < ALIGN(self->current_format.fmt.pix.width * 2, self->halign) *
+					ALIGN(self->current_format.fmt.pix.height, self->valign) * 3 / 2) {
+				pr_err("unexpected value, plane_size=%d\n", plane_size);
+
+				err = -EINVAL;
+				goto err0;
+			}
+			break;
+
+		case QVIO_PIX_FMT_V210:
+			if(plane_size < ALIGN(QVIO_V210_STRIDE(self->current_format.fmt.pix.width), self->halign) *
+					ALIGN(self->current_format.fmt.pix.height, self->valign)) {
+				pr_err("unexpected value, plane_size=%d\n", plane_size);
+
+				err = -EINVAL;
+				goto err0;
+			}
+			break;
+
 		default:
 			pr_err("unexpected value, self->current_format.fmt.pix.pixelformat=0x%X\n", (int)self->current_format.fmt.pix.pixelformat);
 
@@ -427,6 +1535,7 @@ static int __buf_prepare(struct vb2_buffer *buffer) {
 	case V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE:
 		switch(self->current_format.fmt.pix_mp.pixelformat) {
 		case V4L2_PIX_FMT_YUYV:
+		case V4L2_PIX_FMT_UYVY:
 			plane_size = vb2_plane_size(buffer, 0);
 			if(plane_size < ALIGN(self->current_format.fmt.pix_mp.width * 2, self->halign) *
 				ALIGN(self->current_format.fmt.pix_mp.height, self->valign)) {
@@ -472,6 +1581,62 @@ static int __buf_prepare(struct vb2_buffer *buffer) {
 			vb2_set_plane_payload(buffer, 0, plane_size);
 			break;
 
+		case V4L2_PIX_FMT_NV16:
+			plane_size = vb2_plane_size(buffer, 0);
+			if(plane_size < ALIGN(self->current_format.fmt.pix_mp.width, self->halign) *
+				ALIGN(self->current_format.fmt.pix_mp.height, self->valign)) {
+				pr_err("unexpected value, plane_size=%d\n", plane_size);
+
+				err = -EINVAL;
+				goto err0;
+			}
+			vb2_set_plane_payload(buffer, 0, plane_size);
+
+			plane_size = vb2_plane_size(buffer, 1);
+			if(plane_size < ALIGN(self->current_format.fmt.pix_mp.width, self->halign) *
+				ALIGN(self->current_format.fmt.pix_mp.height, self->valign)) {
+				pr_err("unexpected value, plane_size=%d\n", plane_size);
+
+				err = -EINVAL;
+				goto err0;
+			}
+			vb2_set_plane_payload(buffer, 1, plane_size);
+			break;
+
+		case V4L2_PIX_FMT_P010:
+			plane_size = vb2_plane_size(buffer, 0);
+			if(plane_size < ALIGN(self->current_format.fmt.pix_mp.width * 2, self->halign) *
+				ALIGN(self->current_format.fmt.pix_mp.height, self->valign)) {
+				pr_err("unexpected value, plane_size=%d\n", plane_size);
+
+				err = -EINVAL;
+				goto err0;
+			}
+			vb2_set_plane_payload(buffer, 0, plane_size);
+
+			plane_size = vb2_plane_size(buffer, 1);
+			if(plane_size < ALIGN(self->current_format.fmt.pix_mp.width * 2, self->halign) *
+				ALIGN(self->current_format.fmt.pix_mp.height, self->valign) / 2) {
+				pr_err("unexpected value, plane_size=%d\n", plane_size);
+
+				err = -EINVAL;
+				goto err0;
+			}
+			vb2_set_plane_payload(buffer, 1, plane_size);
+			break;
+
+		case QVIO_PIX_FMT_V210:
+			plane_size = vb2_plane_size(buffer, 0);
+			if(plane_size < ALIGN(QVIO_V210_STRIDE(self->current_format.fmt.pix_mp.width), self->halign) *
+				ALIGN(self->current_format.fmt.pix_mp.height, self->valign)) {
+				pr_err("unexpected value, plane_size=%d\n", plane_size);
+
+				err = -EINVAL;
+				goto err0;
+			}
+			vb2_set_plane_payload(buffer, 0, plane_size);
+			break;
+
 		default:
 			pr_err("unexpected value, self->current_format.fmt.pix_mp.pixelformat=0x%X\n", (int)self->current_format.fmt.pix_mp.pixelformat);
 
@@ -489,6 +1654,13 @@ static int __buf_prepare(struct vb2_buffer *buffer) {
 		break;
 	}
 
+	if(V4L2_TYPE_IS_OUTPUT(buffer->type)) {
+		for(p = 0;p < buffer->num_planes;p++) {
+			if(payload[p])
+				vb2_set_plane_payload(buffer, p, payload[p]);
+		}
+	}
+
 	if(vbuf->field == V4L2_FIELD_ANY)
 		vbuf->field = V4L2_FIELD_NONE;
 
@@ -513,13 +1685,49 @@ static void __buf_finish(struct vb2_buffer *buffer) {
 }
 
 static void __buf_queue(struct vb2_buffer *buffer) {
+	int err;
 	struct qvio_queue* self = vb2_get_drv_priv(buffer->vb2_queue);
+	struct qvio_video* video = container_of(self, struct qvio_video, queue);
 	struct vb2_v4l2_buffer *vbuf = to_vb2_v4l2_buffer(buffer);
 	struct qvio_queue_buffer* buf = container_of(vbuf, struct qvio_queue_buffer, vb);
 
-#if 0 // DEBUG
-	pr_info("param: %p %p %d %p\n", self, vbuf, vbuf->vb2_buf.index, buf);
-#endif
+#if 0 // DEBUG
+	pr_info("param: %p %p %d %p\n", self, vbuf, vbuf->vb2_buf.index, buf);
+#endif
+
+	// streaming already, hand it to the daemon right away, or at the next boundary if paced
+	if(vb2_start_streaming_called(buffer->vb2_queue) && video->user_job_ctrl.enable && ! self->clock_enable) {
+		err = __buf_user_job_post(self, buf);
+		if(err) {
+			pr_err("__buf_user_job_post() failed, err=%d\n", err);
+			vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_ERROR);
+		}
+
+		return;
+	}
+
+#if 1 // USE_LIBXDMA
+	// streaming already, hand it to the engine right away
+	if(vb2_start_streaming_called(buffer->vb2_queue) && video->qdev->xdev) {
+		mutex_lock(&self->buffers_mutex);
+		if(self->offline) {
+			// held until the engine is online again
+			list_add_tail(&buf->list_ready, &self->buffers);
+			mutex_unlock(&self->buffers_mutex);
+
+			return;
+		}
+		mutex_unlock(&self->buffers_mutex);
+
+		err = __buf_submit(self, buf);
+		if(err) {
+			pr_err("__buf_submit() failed, err=%d\n", err);
+			vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_ERROR);
+		}
+
+		return;
+	}
+#endif // USE_LIBXDMA
 
 	if (!mutex_lock_interruptible(&self->buffers_mutex)) {
 		list_add_tail(&buf->list_ready, &self->buffers);
@@ -581,8 +1789,6 @@ static int __stream_main(void * data) {
 
 #if 1 // USE_LIBXDMA
 	struct xdma_dev *xdev = qdev->xdev;
-	void __iomem *reg;
-	u32 w;
 #endif // USE_LIBXDMA
 
 	ssize_t size;
@@ -617,21 +1823,13 @@ static int __stream_main(void * data) {
 			switch(qdev->device_id) {
 			case 0xF7150002:
 			case 0xF7570001:
-				reg = xdev->bar[xdev->user_bar_idx] + 0x00D0;
-				w = ioread32(reg);
-
-				w |= 0x00000001; // streamon
-
-				iowrite32(w, reg);
+				qvio_regs_update(&qdev->regs, 0x00D0, 0x00000001, 0x00000001); // streamon
+				qvio_regs_flush(&qdev->regs);
 				break;
 
 			case 0xF7570601:
-				reg = xdev->bar[xdev->user_bar_idx] + 0x00D0;
-				w = ioread32(reg);
-
-				w |= 0x00000010; // streamon
-
-				iowrite32(w, reg);
+				qvio_regs_update(&qdev->regs, 0x00D0, 0x00000010, 0x00000010); // streamon
+				qvio_regs_flush(&qdev->regs);
 				break;
 			}
 
@@ -648,9 +1846,7 @@ static int __stream_main(void * data) {
 		}
 #endif // USE_LIBXDMA
 
-		buf->vb.vb2_buf.timestamp = ktime_get_ns();
-		buf->vb.field = V4L2_FIELD_NONE;
-		buf->vb.sequence = self->sequence++;
+		__buf_stamp(self, buf);
 
 		vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_DONE);
 		buf = NULL;
@@ -668,76 +1864,241 @@ static int __stream_main(void * data) {
 }
 #endif // USE_LIBXDMA
 
+#if 1 // USE_LIBXDMA
+static int __buf_submit(struct qvio_queue* self, struct qvio_queue_buffer* buf) {
+	int err;
+	struct qvio_video* video = container_of(self, struct qvio_video, queue);
+	struct xdma_dev *xdev = video->qdev->xdev;
+	ssize_t size;
+	int i;
+
+	__watchdog_arm(self);
+
+	// the frames dropped by decimation go to the scratch target first
+	for(i = 0;i < self->skip;i++) {
+		size = xdma_xfer_submit_nowait(&buf->skip_cbs[i], xdev, video->channel, false, 0, &self->scratch_sgt, true, 0);
+		if((int)size < 0 && (int)size != -EIOCBQUEUED) {
+			err = (int)size;
+			pr_err("xdma_xfer_submit_nowait() failed, err=%d, skip=%d", err, i);
+
+			goto err0;
+		}
+	}
+
+	if(self->slices <= 1) {
+		size = xdma_xfer_submit_nowait(&buf->io_cb, xdev, video->channel, false, 0, &buf->sgt, true, 0);
+		if((int)size < 0 && (int)size != -EIOCBQUEUED) {
+			err = (int)size;
+			pr_err("xdma_xfer_submit_nowait() failed, err=%d", err);
+
+			goto err0;
+		}
+
+		return 0;
+	}
+
+	if(buf->slices_req != self->slices) {
+		err = __buf_slices_build(self, buf, self->slices);
+		if(err) {
+			pr_err("__buf_slices_build() failed, err=%d\n", err);
+			goto err0;
+		}
+		buf->slices_req = self->slices;
+	}
+
+	buf->slices_err = 0;
+	buf->sequenced = false;
+	atomic_set(&buf->slices_pending, buf->slices_num);
+
+	// one descriptor chain, and so one completion, per slice
+	for(i = 0;i < buf->slices_num;i++) {
+		struct qvio_queue_slice* slice = &buf->slices[i];
+
+		size = xdma_xfer_submit_nowait(&slice->io_cb, xdev, video->channel, false, 0, &slice->sgt, true, 0);
+		if((int)size < 0 && (int)size != -EIOCBQUEUED) {
+			err = (int)size;
+			pr_err("xdma_xfer_submit_nowait() failed, err=%d, slice=%d", err, i);
+
+			goto err0;
+		}
+	}
+
+	return 0;
+
+err0:
+	__watchdog_kick(self, true);
+	return err;
+}
+#endif // USE_LIBXDMA
+
+// STREAMON failed part way, everything handed out so far goes back to vb2 as queued
+static int __start_unwind(struct qvio_queue* self, struct qvio_queue_buffer* failed, bool submitted) {
+	int err = 0;
+	struct qvio_video* video = container_of(self, struct qvio_video, queue);
+	struct qvio_queue_buffer* buf;
+	struct qvio_queue_buffer* node;
+
+	__watchdog_stop(self);
+
+	mutex_lock(&self->buffers_mutex);
+	list_for_each_entry_safe(buf, node, &self->buffers, list_ready) {
+		list_del(&buf->list_ready);
+		vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_QUEUED);
+	}
+	mutex_unlock(&self->buffers_mutex);
+
+#if 1 // USE_LIBXDMA
+	// transfers in flight are drained as aborted, their completions hand the buffers back
+	if(submitted && video->qdev->xdev) {
+		err = qvio_device_engine_reset(video->qdev, video->channel);
+		if(err)
+			pr_err("qvio_device_engine_reset() failed, err=%d\n", err);
+	}
+#endif // USE_LIBXDMA
+
+	if(failed)
+		vb2_buffer_done(&failed->vb.vb2_buf, VB2_BUF_STATE_QUEUED);
+
+	// posted buffers come back through __buf_user_job_done()
+	if(video->user_job_ctrl.enable) {
+		__deadline_stop(self);
+		qvio_user_job_cancel(&video->user_job_ctrl);
+	}
+
+	return err;
+}
+
+// the armed members have been waiting for the streamon write, none of them timed out meanwhile
+static void __group_watchdog_start(struct qvio_device* qdev) {
+	int i;
+
+	for(i = 0;i < QVIO_MAX_VIDEO;i++) {
+		if(qdev->video[i] && qvio_group_armed(&qdev->group, qdev->video[i]->channel))
+			__watchdog_start(&qdev->video[i]->queue);
+	}
+}
+
+// source frame interval, from the detected signal or the nominal card rate, decimation aside
+static u64 __frame_interval(struct qvio_queue* self) {
+	struct qvio_video* video = container_of(self, struct qvio_video, queue);
+	struct v4l2_dv_timings timings;
+	u64 total;
+
+	if(! qvio_source_g_timings(&video->source, &timings) && timings.bt.pixelclock) {
+		total = (u64)V4L2_DV_BT_FRAME_WIDTH(&timings.bt) * V4L2_DV_BT_FRAME_HEIGHT(&timings.bt);
+		if(total)
+			return div64_u64(total * NSEC_PER_SEC, timings.bt.pixelclock);
+	}
+
+	return NSEC_PER_SEC / QVIO_FRAME_RATE;
+}
+
 static int __start_streaming(struct vb2_queue *queue, unsigned int count) {
 	int err;
 	struct qvio_queue* self = container_of(queue, struct qvio_queue, queue);
 	struct qvio_video* video = container_of(self, struct qvio_video, queue);
 	struct qvio_device* qdev = video->qdev;
-	struct qvio_queue_buffer* buf;
-	ssize_t size;
+	struct qvio_queue_buffer* buf = NULL;
+	bool submitted = false;
+	int frame_size;
 
 #if 1 // USE_LIBXDMA
-	struct xdma_dev *xdev = qdev->xdev;
-	void __iomem *reg;
 	u32 w;
 #endif // USE_LIBXDMA
 
 	pr_info("\n");
 
 	self->sequence = 0;
+	self->frame_interval = __frame_interval(self);
+	qvio_sof_reset(&self->sof, self->frame_interval);
+	self->slices = 1;
+	if(self->current_format.type == V4L2_BUF_TYPE_VIDEO_CAPTURE &&
+		self->current_format.fmt.pix.bytesperline > 0)
+		self->slices = clamp_t(int, slices, 1, QVIO_MAX_SLICES);
+
+	// kept across STREAMOFF, transfers still in flight may target it
+	__scratch_free(self);
+
+	self->skip = 0;
+	if(self->decimate > 1 && qdev->xdev) {
+		switch(self->current_format.type) {
+		case V4L2_BUF_TYPE_VIDEO_CAPTURE:
+			frame_size = self->current_format.fmt.pix.sizeimage;
+			break;
+
+		case V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE:
+			frame_size = self->current_format.fmt.pix_mp.plane_fmt[0].sizeimage;
+			break;
+
+		default:
+			frame_size = 0;
+			break;
+		}
+
+		if(frame_size > 0) {
+			err = __scratch_alloc(self, frame_size);
+			if(err) {
+				pr_err("__scratch_alloc() failed, err=%d\n", err);
+				goto err0;
+			}
+
+			self->skip = min(self->decimate, QVIO_MAX_DECIMATE) - 1;
+		}
+	}
 
 #if 1 // USE_LIBXDMA
 	switch(qdev->device_id) {
 	case 0xF7150002:
 	case 0xF7570001:
-		reg = xdev->bar[xdev->user_bar_idx] + 0x00D0;
-		w = ioread32(reg);
-
 		switch(self->current_format.fmt.pix.pixelformat) {
 		case V4L2_PIX_FMT_YUYV:
-			w |= 0x00004110;
+			w = 0x00004110;
 			break;
 
 		case V4L2_PIX_FMT_NV12:
-			w |= 0x00004120;
+			w = 0x00004120;
 			break;
 
 		case V4L2_PIX_FMT_M420:
-			w |= 0x00004120;
+			w = 0x00004120;
 			break;
 
+		// no 0xD0 code for UYVY/NV16/P010/v210, qvio_video_try_fmt() never lets them reach a card
 		default:
 			pr_err("unexpected, self->current_format.fmt.pix.pixelformat=0x%X\n", (int)self->current_format.fmt.pix.pixelformat);
+			w = 0;
 			break;
 		}
 
-		w &= ~0x00000001; // streamoff
+		// pixel format, streamoff
+		qvio_regs_update(&qdev->regs, 0x00D0, 0x000000F0 | w | 0x00000001, w & ~0x00000001);
+		qvio_regs_flush(&qdev->regs);
 		break;
 
 	case 0xF7570601:
-		reg = xdev->bar[xdev->user_bar_idx] + 0x00D0;
-		w = ioread32(reg);
-
 		switch(self->current_format.fmt.pix.pixelformat) {
 		case V4L2_PIX_FMT_YUYV:
-			w |= 0x00084112;
+			w = 0x00084112;
 			break;
 
 		case V4L2_PIX_FMT_NV12:
-			w |= 0x00084122;
+			w = 0x00084122;
 			break;
 
 		case V4L2_PIX_FMT_M420:
-			w |= 0x00084122;
+			w = 0x00084122;
 			break;
 
+		// no 0xD0 code for UYVY/NV16/P010/v210, qvio_video_try_fmt() never lets them reach a card
 		default:
 			pr_err("unexpected, self->current_format.fmt.pix.pixelformat=0x%X\n", (int)self->current_format.fmt.pix.pixelformat);
+			w = 0;
 			break;
 		}
-		w &= ~0x00000010; // streamoff
 
-		iowrite32(w, reg);
+		// pixel format, streamoff
+		qvio_regs_update(&qdev->regs, 0x00D0, 0x000000F0 | w | 0x00000010, w & ~0x00000010);
+		qvio_regs_flush(&qdev->regs);
 		break;
 	}
 
@@ -750,16 +2111,31 @@ static int __start_streaming(struct vb2_queue *queue, unsigned int count) {
 
 	wake_up_process(self->task);
 #else
+	__watchdog_prepare(self);
+
+	// the daemon owes one frame per interval from here on
+	if(video->user_job_ctrl.enable) {
+		err = __deadline_start(self);
+		if(err) {
+			pr_err("__deadline_start() failed, err=%d\n", err);
+
+			goto err1;
+		}
+	}
+
 	// submit all buffers
 	while(true) {
 		err = mutex_lock_interruptible(&self->buffers_mutex);
 		if (err) {
 			pr_err("mutex_lock_interruptible() failed, err=%d\n", err);
 
-			goto err0;
+			buf = NULL;
+			goto err2;
 		}
 
-		if (list_empty(&self->buffers)) {
+		// held until the engine is online again
+		if (list_empty(&self->buffers) ||
+			(self->offline && ! video->user_job_ctrl.enable)) {
 			mutex_unlock(&self->buffers_mutex);
 			break;
 		}
@@ -768,41 +2144,54 @@ static int __start_streaming(struct vb2_queue *queue, unsigned int count) {
 		list_del(&buf->list_ready);
 		mutex_unlock(&self->buffers_mutex);
 
-#if 1 // USE_LIBXDMA
-		pr_info("++++\n");
-		size = xdma_xfer_submit_nowait(&buf->io_cb, xdev, video->channel, false, 0, &buf->sgt, true, 0);
-		if((int)size < 0) {
-			err = (int)size;
-			if(err == -EIOCBQUEUED)
-				continue;
+		if(video->user_job_ctrl.enable) {
+			err = __buf_user_job_post(self, buf);
+			if(err) {
+				pr_err("__buf_user_job_post() failed, err=%d", err);
 
-			pr_err("xdma_xfer_submit_nowait() failed, err=%d", err);
+				goto err2;
+			}
 
-			goto err0;
+			// paced, the frame clock posts the rest one per boundary
+			if(self->clock_enable)
+				break;
+			continue;
+		}
+
+#if 1 // USE_LIBXDMA
+		// a failed submit may have queued some of its transfers already
+		submitted = true;
+		err = __buf_submit(self, buf);
+		if(err) {
+			pr_err("__buf_submit() failed, err=%d", err);
+
+			goto err2;
 		}
-		pr_info("----\n");
 #endif // USE_LIBXDMA
 	}
 
+	// grouped channels go live together, on the streamon write of the last one
+	if(qvio_group_has(&qdev->group, video->channel)) {
+		if(! qvio_group_arm(&qdev->group, video->channel, self->frame_interval)) {
+			pr_info("armed, channel=%d\n", video->channel);
+			return 0;
+		}
+
+		__group_watchdog_start(qdev);
+	} else
+		__watchdog_start(self);
+
 #if 1 // USE_LIBXDMA
 	switch(qdev->device_id) {
 	case 0xF7150002:
 	case 0xF7570001:
-		reg = xdev->bar[xdev->user_bar_idx] + 0x00D0;
-		w = ioread32(reg);
-
-		w |= 0x00000001; // streamon
-
-		iowrite32(w, reg);
+		qvio_regs_update(&qdev->regs, 0x00D0, 0x00000001, 0x00000001); // streamon
+		qvio_regs_flush(&qdev->regs);
 		break;
 
 	case 0xF7570601:
-		reg = xdev->bar[xdev->user_bar_idx] + 0x00D0;
-		w = ioread32(reg);
-
-		w |= 0x00000010; // streamon
-
-		iowrite32(w, reg);
+		qvio_regs_update(&qdev->regs, 0x00D0, 0x00000010, 0x00000010); // streamon
+		qvio_regs_flush(&qdev->regs);
 		break;
 	}
 #endif // USE_LIBXDMA
@@ -813,42 +2202,47 @@ static int __start_streaming(struct vb2_queue *queue, unsigned int count) {
 
 	return 0;
 
+err2:
+	// the scratch stays if the engine could not be drained, the next STREAMON frees it
+	if(__start_unwind(self, buf, submitted))
+		goto err0;
+err1:
+	__watchdog_stop(self);
+	__scratch_free(self);
 err0:
-	return -EIO;
+	// the rest of the group waits for a member that never went live
+	if(qvio_group_has(&qdev->group, video->channel))
+		qvio_group_disarm(&qdev->group, video->channel);
+
+	return err;
 }
 
 static void __stop_streaming(struct vb2_queue *queue) {
 	struct qvio_queue* self = container_of(queue, struct qvio_queue, queue);
 	struct qvio_video* video = container_of(self, struct qvio_video, queue);
 	struct qvio_device* qdev = video->qdev;
-
-#if 1 // USE_LIBXDMA
-	struct xdma_dev *xdev = qdev->xdev;
-	void __iomem *reg;
-	u32 w;
-#endif // USE_LIBXDMA
+	bool streamoff = true;
 
 	pr_info("\n");
 
+	// a group keeps streaming until its last member stops
+	if(qvio_group_has(&qdev->group, video->channel))
+		streamoff = qvio_group_disarm(&qdev->group, video->channel);
+
+	// no engine reset from here on
+	__watchdog_stop(self);
+
 #if 1 // USE_LIBXDMA
-	switch(qdev->device_id) {
+	if(streamoff) switch(qdev->device_id) {
 	case 0xF7150002:
 	case 0xF7570001:
-		reg = xdev->bar[xdev->user_bar_idx] + 0x00D0;
-		w = ioread32(reg);
-
-		w &= ~0x00000001; // streamoff
-
-		iowrite32(w, reg);
+		qvio_regs_update(&qdev->regs, 0x00D0, 0x00000001, 0); // streamoff
+		qvio_regs_flush(&qdev->regs);
 		break;
 
 	case 0xF7570601:
-		reg = xdev->bar[xdev->user_bar_idx] + 0x00D0;
-		w = ioread32(reg);
-
-		w &= ~0x00000010; // streamoff
-
-		iowrite32(w, reg);
+		qvio_regs_update(&qdev->regs, 0x00D0, 0x00000010, 0); // streamoff
+		qvio_regs_flush(&qdev->regs);
 		break;
 	}
 
@@ -861,6 +2255,13 @@ static void __stop_streaming(struct vb2_queue *queue) {
 	}
 #endif // USE_LIBXDMA
 
+	// buffers still with the daemon come back as errors
+	if(video->user_job_ctrl.enable) {
+		__deadline_stop(self);
+
+		qvio_user_job_cancel(&video->user_job_ctrl);
+	}
+
 	if (!mutex_lock_interruptible(&self->buffers_mutex)) {
 		struct qvio_queue_buffer* buf;
 		struct qvio_queue_buffer* node;
@@ -892,8 +2293,17 @@ static const struct vb2_ops qvio_vb2_ops = {
 };
 
 int qvio_queue_start(struct qvio_queue* self, enum v4l2_buf_type type) {
+	int err;
+
 	pr_info("\n");
 
+	self->map_wq = alloc_workqueue("qvio-map", WQ_UNBOUND | WQ_HIGHPRI, 0);
+	if(! self->map_wq) {
+		pr_err("alloc_workqueue() failed\n");
+		err = -ENOMEM;
+		goto err0;
+	}
+
 	self->queue.type = type;
 	if(type == V4L2_BUF_TYPE_VIDEO_CAPTURE ||
 		type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
@@ -906,7 +2316,10 @@ int qvio_queue_start(struct qvio_queue* self, enum v4l2_buf_type type) {
 	self->queue.buf_struct_size = sizeof(struct qvio_queue_buffer);
 	self->queue.mem_ops = &vb2_vmalloc_memops;
 	self->queue.ops = &qvio_vb2_ops;
-	self->queue.timestamp_flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+	if(V4L2_TYPE_IS_OUTPUT(type))
+		self->queue.timestamp_flags = V4L2_BUF_FLAG_TIMESTAMP_COPY;
+	else
+		self->queue.timestamp_flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
 
 #if LINUX_VERSION_CODE <= KERNEL_VERSION(6,8,0)
 	self->queue.min_buffers_needed = 2;
@@ -915,16 +2328,159 @@ int qvio_queue_start(struct qvio_queue* self, enum v4l2_buf_type type) {
 #endif
 
 	return 0;
+
+err0:
+	return err;
 }
 
 void qvio_queue_stop(struct qvio_queue* self) {
 	pr_info("\n");
+
+	__scratch_free(self);
+
+	if(self->map_wq) {
+		destroy_workqueue(self->map_wq);
+		self->map_wq = NULL;
+	}
 }
 
 struct vb2_queue* qvio_queue_get_vb2_queue(struct qvio_queue* self) {
 	return &self->queue;
 }
 
+unsigned int qvio_queue_num_buffers(struct qvio_queue* self) {
+#if LINUX_VERSION_CODE <= KERNEL_VERSION(6,8,0)
+	return self->queue.num_buffers;
+#else
+	return vb2_get_num_buffers(&self->queue) ? self->queue.max_num_buffers : 0;
+#endif
+}
+
+// BUF_INIT answer, runs in the daemon's context so dma_buf is one of its fds
+void qvio_queue_buf_init_done(void* user, struct qvio_user_job_done* user_job_done) {
+	struct vb2_buffer* buffer = user;
+	struct qvio_queue* self = vb2_get_drv_priv(buffer->vb2_queue);
+	struct vb2_v4l2_buffer *vbuf = to_vb2_v4l2_buffer(buffer);
+	struct qvio_queue_buffer* buf = container_of(vbuf, struct qvio_queue_buffer, vb);
+	struct dma_buf* dmabuf;
+	__u32 bytesperline;
+	bool mplane;
+	int i;
+
+	if(! user_job_done || buffer->memory != V4L2_MEMORY_MMAP)
+		return;
+
+	buf->buf_init.flags = user_job_done->u.buf_init.flags;
+	buf->buf_init.dma_buf = user_job_done->u.buf_init.dma_buf;
+	memcpy(buf->buf_init.offset, user_job_done->u.buf_init.offset, sizeof(buf->buf_init.offset));
+	memcpy(buf->buf_init.pitch, user_job_done->u.buf_init.pitch, sizeof(buf->buf_init.pitch));
+	memcpy(buf->buf_init.psize, user_job_done->u.buf_init.psize, sizeof(buf->buf_init.psize));
+
+	// no dma-buf, the vmalloc buffer stays
+	if(buf->buf_init.flags < 0 || buf->buf_init.dma_buf < 0)
+		return;
+
+	dmabuf = dma_buf_get(buf->buf_init.dma_buf);
+	if(IS_ERR(dmabuf)) {
+		pr_err("dma_buf_get() failed, err=%d\n", (int)PTR_ERR(dmabuf));
+		return;
+	}
+
+	// the format stays what S_FMT negotiated, the layout has to match it on every plane,
+	// the chroma of a single-planar format shares the luma's bytesperline
+	mplane = (self->current_format.type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE ||
+		self->current_format.type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE);
+
+	for(i = 0;i < 4;i++) {
+		if(! buf->buf_init.pitch[i])
+			continue;
+
+		if(mplane && i >= buffer->num_planes) {
+			pr_err("unexpected value, pitch[%d]=%d num_planes=%u\n", i, buf->buf_init.pitch[i], buffer->num_planes);
+			goto err0;
+		}
+
+		bytesperline = mplane ? self->current_format.fmt.pix_mp.plane_fmt[i].bytesperline :
+			self->current_format.fmt.pix.bytesperline;
+		if(bytesperline && buf->buf_init.pitch[i] != bytesperline) {
+			pr_err("unexpected value, pitch[%d]=%d != %u\n", i, buf->buf_init.pitch[i], bytesperline);
+			goto err0;
+		}
+	}
+
+	for(i = 0;i < buffer->num_planes && i < 4;i++) {
+		if(dmabuf->size < vb2_plane_size(buffer, i)) {
+			pr_err("unexpected value, size=%zu < plane_size[%d]=%lu\n", dmabuf->size, i, vb2_plane_size(buffer, i));
+			goto err0;
+		}
+
+		if(buf->buf_init.psize[i] && (buf->buf_init.psize[i] < 0 ||
+			(unsigned long)buf->buf_init.psize[i] < vb2_plane_size(buffer, i))) {
+			pr_err("unexpected value, psize[%d]=%d < %lu\n", i, buf->buf_init.psize[i], vb2_plane_size(buffer, i));
+			goto err0;
+		}
+
+		if(buf->buf_init.offset[i] < 0 || ! PAGE_ALIGNED(buf->buf_init.offset[i]) ||
+			buf->buf_init.offset[i] + vb2_plane_size(buffer, i) > dmabuf->size) {
+			pr_err("unexpected value, offset[%d]=%d length=%lu size=%zu\n",
+				i, buf->buf_init.offset[i], vb2_plane_size(buffer, i), dmabuf->size);
+			goto err0;
+		}
+	}
+
+	mutex_lock(&self->queue.mmap_lock);
+	if(buf->dmabuf)
+		dma_buf_put(buf->dmabuf);
+	buf->dmabuf = dmabuf;
+	mutex_unlock(&self->queue.mmap_lock);
+
+#if 0 // DEBUG
+	pr_info("index=%d dmabuf=%p size=%zu\n", buffer->index, dmabuf, dmabuf->size);
+#endif
+
+	return;
+
+err0:
+	dma_buf_put(dmabuf);
+}
+
+// adopted planes map the daemon's dma-buf, the rest go to vb2
+int qvio_queue_mmap(struct qvio_queue* self, struct vm_area_struct *vma) {
+	int err;
+	struct vb2_buffer* buffer;
+	struct qvio_queue_buffer* buf;
+	unsigned long offset = vma->vm_pgoff << PAGE_SHIFT;
+	unsigned int i;
+	int p;
+
+	mutex_lock(&self->queue.mmap_lock);
+	for(i = 0;i < qvio_queue_num_buffers(self);i++) {
+		buffer = vb2_get_buffer(&self->queue, i);
+		if(! buffer || buffer->memory != V4L2_MEMORY_MMAP)
+			continue;
+
+		buf = container_of(to_vb2_v4l2_buffer(buffer), struct qvio_queue_buffer, vb);
+		if(! buf->dmabuf)
+			continue;
+
+		for(p = 0;p < buffer->num_planes && p < 4;p++) {
+			if(buffer->planes[p].m.offset != offset)
+				continue;
+
+			err = dma_buf_mmap(buf->dmabuf, vma, buf->buf_init.offset[p] >> PAGE_SHIFT);
+			mutex_unlock(&self->queue.mmap_lock);
+
+			if(err)
+				pr_err("dma_buf_mmap() failed, err=%d\n", err);
+
+			return err;
+		}
+	}
+	mutex_unlock(&self->queue.mmap_lock);
+
+	return vb2_mmap(&self->queue, vma);
+}
+
 int qvio_queue_s_fmt(struct qvio_queue* self, struct v4l2_format *format) {
 	pr_info("\n");
 
@@ -948,3 +2504,73 @@ int qvio_queue_try_buf_done(struct qvio_queue* self) {
 
 	return 0;
 }
+
+void qvio_queue_offline(struct qvio_queue* self) {
+	mutex_lock(&self->buffers_mutex);
+	self->offline = true;
+	mutex_unlock(&self->buffers_mutex);
+}
+
+void qvio_queue_online(struct qvio_queue* self) {
+	int err;
+	struct qvio_video* video = container_of(self, struct qvio_video, queue);
+	struct qvio_queue_buffer* buf;
+
+	mutex_lock(&self->buffers_mutex);
+	self->offline = false;
+
+#if 1 // USE_LIBXDMA
+	// the buffers held while offline, in queueing order
+	if(vb2_start_streaming_called(&self->queue) && ! video->user_job_ctrl.enable) {
+		while(! list_empty(&self->buffers)) {
+			buf = list_entry(self->buffers.next, struct qvio_queue_buffer, list_ready);
+			list_del(&buf->list_ready);
+
+			err = __buf_submit(self, buf);
+			if(err) {
+				pr_err("__buf_submit() failed, err=%d\n", err);
+				vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_ERROR);
+			}
+		}
+	}
+#endif // USE_LIBXDMA
+
+	mutex_unlock(&self->buffers_mutex);
+}
+
+bool qvio_queue_has_frame_sync(struct qvio_queue* self) {
+	struct qvio_video* video = container_of(self, struct qvio_video, queue);
+
+	if(V4L2_TYPE_IS_OUTPUT(self->queue.type))
+		return false;
+
+	if(frame_sync_irq >= 0)
+		return true;
+
+	// single-planar engine capture is sliced at STREAMON
+	return slices > 1 && self->queue.type == V4L2_BUF_TYPE_VIDEO_CAPTURE &&
+		video->qdev->xdev && ! video->user_job_ctrl.enable;
+}
+
+void qvio_queue_user_irq(struct qvio_queue* self, int irq) {
+	struct qvio_video* video = container_of(self, struct qvio_video, queue);
+	struct qvio_group* group = &video->qdev->group;
+	unsigned long flags;
+	u64 now = ktime_get_ns();
+	u32 sequence;
+
+	if(irq != frame_sync_irq || ! vb2_start_streaming_called(&self->queue))
+		return;
+
+	// each interrupt is the next frame, the frame completes with the sequence counted here
+	if(qvio_group_has(group, video->channel)) {
+		if(! qvio_group_sof_irq(group, now, &sequence))
+			return;
+	} else {
+		spin_lock_irqsave(&self->sequence_lock, flags);
+		sequence = qvio_sof_irq(&self->sof, now);
+		spin_unlock_irqrestore(&self->sequence_lock, flags);
+	}
+
+	__frame_sync(self, sequence);
+}
@@ -4,6 +4,17 @@
 #include <media/videobuf2-core.h>
 #include <linux/videodev2.h>
 #include <linux/sched.h>
+#include <linux/workqueue.h>
+#include <linux/hrtimer.h>
+
+#include "group.h"
+
+#define QVIO_MAX_SLICES 16
+#define QVIO_FRAME_RATE 60
+#define QVIO_MAX_DECIMATE 60
+
+// v210, 6 pixels per 16 bytes, rows padded to 48 pixels
+#define QVIO_V210_STRIDE(w) (DIV_ROUND_UP(w, 48) * 128)
 
 struct qvio_queue {
 	struct vb2_queue queue;
@@ -11,11 +22,70 @@ struct qvio_queue {
 	struct list_head buffers;
 	struct mutex buffers_mutex;
 	struct v4l2_format current_format;
+	spinlock_t sequence_lock;
 	__u32 sequence;
+	u64 frame_interval; // source frame interval, ns, set at STREAMON
+	struct qvio_sof sof; // counted by the frame_sync_irq line, completions take their sequence from it
 	int halign, valign;
+	int slices;
+	int decimate;
+	int skip;
+
+	// scratch target for the frames dropped by decimation
+	void* scratch_virt;
+	dma_addr_t scratch_dma;
+	struct sg_table scratch_sgt;
 
 	// kthread for data pull
 	struct task_struct* task;
+
+	// the channel's engine is offline, buffers queued meanwhile are held in buffers
+	bool offline;
+
+	// transfer-timeout watchdog, pushed back by every completion while buffers are in flight
+	int watchdog_frames;
+	bool watchdog_enable;
+	unsigned long watchdog_timeout; // jiffies
+	atomic_t watchdog_inflight;
+	struct delayed_work watchdog_work;
+	u32 watchdog_recoveries;
+	u32 watchdog_failures;
+	u64 watchdog_last;
+
+	// unbound workqueue for parallel buffer dma mapping at REQBUFS
+	struct workqueue_struct* map_wq;
+
+	// user-job deadline, buffers with the daemon in posting order
+	spinlock_t posted_lock;
+	struct list_head posted;
+	int deadline_fallback;
+	int deadline_credit;
+	u32 deadline_misses;
+	ktime_t deadline_interval;
+	struct hrtimer deadline_timer;
+	struct work_struct deadline_work;
+
+	// user-job frame clock, one buffer posted and one completed per frame boundary
+	int frame_clock;
+	bool clock_enable;
+	struct list_head clock_ready; // answered by the daemon, due at the next boundary
+	ktime_t clock_next;
+	ktime_t clock_boundary;
+	u64 clock_step;
+	u32 clock_rem, clock_acc, clock_den;
+	u32 clock_due;
+	u64 clock_ticks;
+	u32 clock_frames;
+	u32 clock_underruns;
+	u32 clock_overruns;
+	u64 clock_jitter_sum;
+	u32 clock_jitter_max;
+	s32 clock_drift;
+
+	// last good frame or slate, what a missed frame is completed with
+	struct mutex fallback_mutex;
+	void* fallback_frame;
+	unsigned long fallback_size;
 };
 
 void qvio_queue_init(struct qvio_queue* self);
@@ -24,9 +94,24 @@ int qvio_queue_start(struct qvio_queue* self, enum v4l2_buf_type type);
 void qvio_queue_stop(struct qvio_queue* self);
 
 struct vb2_queue* qvio_queue_get_vb2_queue(struct qvio_queue* self);
+unsigned int qvio_queue_num_buffers(struct qvio_queue* self);
+int qvio_queue_mmap(struct qvio_queue* self, struct vm_area_struct *vma);
+
+// qvio_user_job_done_handler for BUF_INIT, user is the vb2_buffer
+struct qvio_user_job_done;
+void qvio_queue_buf_init_done(void* user, struct qvio_user_job_done* user_job_done);
 int qvio_queue_s_fmt(struct qvio_queue* self, struct v4l2_format *format);
 int qvio_queue_g_fmt(struct qvio_queue* self, struct v4l2_format *format);
 
 int qvio_queue_try_buf_done(struct qvio_queue* self);
 
+// around xdma_engine_offline/online of the channel's engine
+void qvio_queue_offline(struct qvio_queue* self);
+void qvio_queue_online(struct qvio_queue* self);
+
+// user IRQ of the card, V4L2_EVENT_FRAME_SYNC on the start-of-frame line, any context
+void qvio_queue_user_irq(struct qvio_queue* self, int irq);
+// a start-of-frame source exists, the frame_sync_irq line or the first of several slices
+bool qvio_queue_has_frame_sync(struct qvio_queue* self);
+
 #endif // __QVIO_QUEUE_H__
\ No newline at end of file
@@ -0,0 +1,139 @@
+#define pr_fmt(fmt)     "[" KBUILD_MODNAME "]%s(#%d): " fmt, __func__, __LINE__
+
+#include "regs.h"
+
+#include <linux/module.h>
+#include <linux/spinlock.h>
+#include <linux/io.h>
+
+static int regs_cache = 1;
+module_param(regs_cache, int, 0444);
+MODULE_PARM_DESC(regs_cache, "Shadow the card's control registers, 0 - off, 1 - on (default)");
+
+// control registers only the driver writes, status registers stay volatile
+static const u32 __cached_regs[] = {
+	0x00D0, // stream control and pixel format
+};
+
+static inline bool __is_cached(struct qvio_regs* self, u32 offset) {
+	return offset < QVIO_REGS_WORDS * 4 && (self->cached & BIT_ULL(offset >> 2));
+}
+
+void qvio_regs_init(struct qvio_regs* self, void __iomem* base) {
+	int i;
+
+	self->base = base;
+	spin_lock_init(&self->lock);
+	self->cached = 0;
+	self->valid = 0;
+	self->dirty = 0;
+
+	if(regs_cache) {
+		for(i = 0; i < ARRAY_SIZE(__cached_regs); i++)
+			qvio_regs_set_volatile(self, __cached_regs[i], false);
+	}
+}
+
+void qvio_regs_set_volatile(struct qvio_regs* self, u32 offset, bool is_volatile) {
+	unsigned long flags;
+	u64 bit;
+
+	if((offset & 3) || offset >= QVIO_REGS_WORDS * 4) {
+		pr_err("unexpected value, offset=0x%X\n", offset);
+		return;
+	}
+
+	bit = BIT_ULL(offset >> 2);
+
+	spin_lock_irqsave(&self->lock, flags);
+	if(is_volatile) {
+		// what was changed still reaches the card
+		if(self->dirty & bit)
+			iowrite32(self->shadow[offset >> 2], self->base + offset);
+
+		self->cached &= ~bit;
+		self->valid &= ~bit;
+		self->dirty &= ~bit;
+	} else {
+		self->cached |= bit;
+	}
+	spin_unlock_irqrestore(&self->lock, flags);
+}
+
+static u32 __shadow_load(struct qvio_regs* self, u32 offset) {
+	u32 i = offset >> 2;
+
+	if(! (self->valid & BIT_ULL(i))) {
+		self->shadow[i] = ioread32(self->base + offset);
+		self->valid |= BIT_ULL(i);
+	}
+
+	return self->shadow[i];
+}
+
+u32 qvio_regs_read(struct qvio_regs* self, u32 offset) {
+	unsigned long flags;
+	u32 w;
+
+	if(! __is_cached(self, offset))
+		return ioread32(self->base + offset);
+
+	spin_lock_irqsave(&self->lock, flags);
+	w = __shadow_load(self, offset);
+	spin_unlock_irqrestore(&self->lock, flags);
+
+	return w;
+}
+
+void qvio_regs_write(struct qvio_regs* self, u32 offset, u32 value) {
+	qvio_regs_update(self, offset, ~0U, value);
+}
+
+u32 qvio_regs_update(struct qvio_regs* self, u32 offset, u32 mask, u32 value) {
+	unsigned long flags;
+	u32 w;
+
+	if(! __is_cached(self, offset)) {
+		w = (mask == ~0U) ? 0 : ioread32(self->base + offset);
+		w = (w & ~mask) | (value & mask);
+		iowrite32(w, self->base + offset);
+
+		return w;
+	}
+
+	spin_lock_irqsave(&self->lock, flags);
+	w = (mask == ~0U) ? 0 : __shadow_load(self, offset);
+	w = (w & ~mask) | (value & mask);
+	self->shadow[offset >> 2] = w;
+	self->valid |= BIT_ULL(offset >> 2);
+	self->dirty |= BIT_ULL(offset >> 2);
+	spin_unlock_irqrestore(&self->lock, flags);
+
+	return w;
+}
+
+void qvio_regs_flush(struct qvio_regs* self) {
+	unsigned long flags;
+	u64 dirty;
+	int i;
+
+	spin_lock_irqsave(&self->lock, flags);
+	dirty = self->dirty;
+	self->dirty = 0;
+
+	// one burst of posted writes, in register order
+	for(i = 0; dirty; i++, dirty >>= 1) {
+		if(dirty & 1)
+			iowrite32(self->shadow[i], self->base + i * 4);
+	}
+	spin_unlock_irqrestore(&self->lock, flags);
+}
+
+void qvio_regs_invalidate(struct qvio_regs* self) {
+	unsigned long flags;
+
+	spin_lock_irqsave(&self->lock, flags);
+	self->valid = 0;
+	self->dirty = 0;
+	spin_unlock_irqrestore(&self->lock, flags);
+}
@@ -0,0 +1,31 @@
+#ifndef __QVIO_REGS_H__
+#define __QVIO_REGS_H__
+
+#include <linux/types.h>
+#include <linux/spinlock_types.h>
+
+#define QVIO_REGS_WORDS 64 // control block at the start of the user BAR, 0x00 ~ 0xFC
+
+// shadow of the card's writable control registers
+struct qvio_regs {
+	void __iomem* base;
+	spinlock_t lock;
+	u64 cached;		// words served from the shadow, the rest are volatile and always hit the card
+	u64 valid;		// words loaded from the card
+	u64 dirty;		// words changed in the shadow only, up to the next flush
+	u32 shadow[QVIO_REGS_WORDS];
+};
+
+void qvio_regs_init(struct qvio_regs* self, void __iomem* base);
+void qvio_regs_set_volatile(struct qvio_regs* self, u32 offset, bool is_volatile);
+
+// cached words are loaded once, written on flush; anything else goes to the card right away
+u32 qvio_regs_read(struct qvio_regs* self, u32 offset);
+void qvio_regs_write(struct qvio_regs* self, u32 offset, u32 value);
+u32 qvio_regs_update(struct qvio_regs* self, u32 offset, u32 mask, u32 value);
+void qvio_regs_flush(struct qvio_regs* self);
+
+// after the card was reset or written behind the shadow's back
+void qvio_regs_invalidate(struct qvio_regs* self);
+
+#endif // __QVIO_REGS_H__
@@ -0,0 +1,305 @@
+#define pr_fmt(fmt)     "[" KBUILD_MODNAME "]%s(#%d): " fmt, __func__, __LINE__
+
+#include "source.h"
+#include "video.h"
+
+#include <linux/module.h>
+#include <linux/i2c.h>
+#include <linux/timekeeping.h>
+#include <media/v4l2-event.h>
+
+static int source_irq = -1;
+module_param(source_irq, int, 0444);
+MODULE_PARM_DESC(source_irq, "User IRQ line the card raises on an input signal change, -1 - none (default)");
+
+static int source_poll_ms = -1;
+module_param(source_poll_ms, int, 0644);
+MODULE_PARM_DESC(source_poll_ms, "Input signal check interval in ms while the node is open, -1 - 500 without source_irq and none with it (default), 0 - on the user IRQ only");
+
+#define QVIO_SOURCE_POLL_MS			500
+
+// HDMI20_INTERFACE of the MCU, a header then one MCU_RESOLUCTION entry per channel
+#define QVIO_SOURCE_MCU_ADDR		0x32
+
+#define QVIO_SOURCE_TIMING_SIZE		10 // vtotal, htotal, vactive, hactive, fps, modeflag
+
+#define QVIO_SOURCE_MODE_INTERLACED	0x01
+#define QVIO_SOURCE_MODE_1001		0x02
+
+// the user IRQ tells about a change, a poll is only a fallback without it
+static unsigned int __poll_ms(void) {
+	int poll_ms = READ_ONCE(source_poll_ms);
+
+	if(poll_ms >= 0)
+		return poll_ms;
+
+	return (source_irq >= 0) ? 0 : QVIO_SOURCE_POLL_MS;
+}
+
+// header and the channel's entry in one i2c transfer, the entry's timing alone if header is NULL
+static int __mcu_read(struct qvio_source* self, u8* header, u8* entry) {
+	int err;
+	struct qvio_video* video = container_of(self, struct qvio_video, source);
+	u8 header_reg = 0;
+	u8 entry_reg = QVIO_MCU_HEADER_SIZE + QVIO_MCU_ENTRY_SIZE * video->channel;
+	u16 entry_len = header ? QVIO_MCU_ENTRY_SIZE : QVIO_MCU_ENTRY_TIMING + QVIO_SOURCE_TIMING_SIZE;
+	struct i2c_msg msgs[4] = {
+		{ .addr = QVIO_SOURCE_MCU_ADDR, .flags = 0, .len = 1, .buf = &entry_reg },
+		{ .addr = QVIO_SOURCE_MCU_ADDR, .flags = I2C_M_RD, .len = entry_len, .buf = entry },
+		{ .addr = QVIO_SOURCE_MCU_ADDR, .flags = 0, .len = 1, .buf = &header_reg },
+		{ .addr = QVIO_SOURCE_MCU_ADDR, .flags = I2C_M_RD, .len = QVIO_MCU_HEADER_SIZE, .buf = header },
+	};
+	int num = header ? ARRAY_SIZE(msgs) : 2;
+
+	err = i2c_transfer(&video->qdev->i2c.adap, msgs, num);
+	if(err != num) {
+		err = (err < 0) ? err : -EIO;
+		pr_err("i2c_transfer() failed, err=%d\n", err);
+		return err;
+	}
+
+	return 0;
+}
+
+static int __timings_parse(const u8* entry, struct v4l2_dv_timings* timings) {
+	struct v4l2_bt_timings* bt = &timings->bt;
+	const u8* r = entry + QVIO_MCU_ENTRY_TIMING;
+	u32 vtotal, htotal, vactive, hactive, fps;
+	u64 pixelclock;
+
+	memset(timings, 0, sizeof(*timings));
+
+	vtotal = r[0] | (r[1] << 8);
+	htotal = r[2] | (r[3] << 8);
+	vactive = r[4] | (r[5] << 8);
+	hactive = r[6] | (r[7] << 8);
+	fps = r[8];
+
+	if(! vactive || ! hactive || ! fps)
+		return -ENOLINK;
+
+	timings->type = V4L2_DV_BT_656_1120;
+	bt->width = hactive;
+	bt->height = vactive;
+	bt->interlaced = (r[9] & QVIO_SOURCE_MODE_INTERLACED) ? V4L2_DV_INTERLACED : V4L2_DV_PROGRESSIVE;
+
+	// only the blanking totals are known, the porches carry them
+	bt->hbackporch = (htotal > hactive) ? htotal - hactive : 0;
+	bt->vbackporch = (vtotal > vactive) ? vtotal - vactive : 0;
+
+	pixelclock = (u64)max(htotal, hactive) * max(vtotal, vactive) * fps;
+	if(r[9] & QVIO_SOURCE_MODE_1001) {
+		pixelclock = div_u64(pixelclock * 1000, 1001);
+		bt->flags |= V4L2_DV_FL_REDUCED_FPS;
+	}
+	bt->pixelclock = pixelclock;
+
+	return 0;
+}
+
+static bool __timings_equal(struct v4l2_dv_timings* a, struct v4l2_dv_timings* b) {
+	return a->bt.width == b->bt.width &&
+		a->bt.height == b->bt.height &&
+		a->bt.interlaced == b->bt.interlaced &&
+		a->bt.pixelclock == b->bt.pixelclock;
+}
+
+// reads the signal, a change is raised as V4L2_EVENT_SOURCE_CHANGE,
+// table also refreshes the MCU table cache, QVIO_EVENT_MCU_TABLE on a change
+static int __source_check(struct qvio_source* self, struct v4l2_dv_timings* timings, bool table) {
+	int err;
+	struct qvio_video* video = container_of(self, struct qvio_video, source);
+	struct v4l2_event event;
+	u8 header[QVIO_MCU_HEADER_SIZE];
+	u8 entry[QVIO_MCU_ENTRY_SIZE];
+	bool changed, table_changed = false;
+
+	err = __mcu_read(self, table ? header : NULL, entry);
+	if(err)
+		return err;
+
+	err = __timings_parse(entry, timings);
+
+	mutex_lock(&self->lock);
+	if(table) {
+		table_changed = ! self->mcu_valid ||
+			memcmp(header, self->mcu_header, sizeof(header)) ||
+			memcmp(entry, self->mcu_entry, sizeof(entry));
+		if(table_changed) {
+			memcpy(self->mcu_header, header, sizeof(header));
+			memcpy(self->mcu_entry, entry, sizeof(entry));
+			self->mcu_sequence++;
+			self->mcu_valid = true;
+		}
+		self->mcu_timestamp = ktime_get_ns();
+	}
+
+	changed = (! err) != self->valid || (! err && ! __timings_equal(timings, &self->timings));
+	if(changed) {
+		self->valid = ! err;
+		if(self->valid)
+			self->timings = *timings;
+		self->changes++;
+	}
+	mutex_unlock(&self->lock);
+
+	if(changed) {
+		pr_info("channel=%d signal=%d %ux%u%s pixelclock=%llu\n", video->channel, ! err,
+			timings->bt.width, timings->bt.height, timings->bt.interlaced ? "i" : "p",
+			(unsigned long long)timings->bt.pixelclock);
+
+		memset(&event, 0, sizeof(event));
+		event.type = V4L2_EVENT_SOURCE_CHANGE;
+		event.u.src_change.changes = V4L2_EVENT_SRC_CH_RESOLUTION;
+		v4l2_event_queue(video->vdev, &event);
+	}
+
+	if(table_changed) {
+		memset(&event, 0, sizeof(event));
+		event.type = QVIO_EVENT_MCU_TABLE;
+		v4l2_event_queue(video->vdev, &event);
+	}
+
+	return err;
+}
+
+static void __source_work(struct work_struct* work) {
+	struct qvio_source* self = container_of(to_delayed_work(work), struct qvio_source, work);
+	struct v4l2_dv_timings timings;
+	unsigned int poll_ms = __poll_ms();
+	bool table;
+	u32 changes;
+
+	// the table on the user IRQ only, a poll reads the channel's entry
+	table = atomic_xchg(&self->refresh, 0) != 0;
+	changes = READ_ONCE(self->changes);
+	__source_check(self, &timings, table);
+
+	// a signal change found by the poll brings the table along
+	if(! table && READ_ONCE(self->changes) != changes)
+		__source_check(self, &timings, true);
+
+	// nobody to tell about a change, the next open or user IRQ checks again
+	if(poll_ms && atomic_read(&self->users) && READ_ONCE(self->started))
+		queue_delayed_work(system_wq, &self->work, msecs_to_jiffies(poll_ms));
+}
+
+void qvio_source_init(struct qvio_source* self) {
+	mutex_init(&self->lock);
+	INIT_DELAYED_WORK(&self->work, __source_work);
+	self->started = false;
+	atomic_set(&self->users, 0);
+	atomic_set(&self->refresh, 0);
+	self->valid = false;
+	self->changes = 0;
+	memset(&self->timings, 0, sizeof(self->timings));
+	self->mcu_valid = false;
+	self->mcu_sequence = 0;
+	self->mcu_timestamp = 0;
+}
+
+int qvio_source_start(struct qvio_source* self) {
+	struct qvio_video* video = container_of(self, struct qvio_video, source);
+
+	// capture nodes of cards with the i2c adapter only
+	if(video->vfl_dir != VFL_DIR_RX || ! video->qdev->i2c.started)
+		return 0;
+
+	mutex_lock(&self->lock);
+	WRITE_ONCE(self->started, true);
+	atomic_set(&self->refresh, 1);
+	queue_delayed_work(system_wq, &self->work, 0);
+	mutex_unlock(&self->lock);
+
+	return 0;
+}
+
+void qvio_source_stop(struct qvio_source* self) {
+	if(! self->started)
+		return;
+
+	mutex_lock(&self->lock);
+	WRITE_ONCE(self->started, false);
+	mutex_unlock(&self->lock);
+	cancel_delayed_work_sync(&self->work);
+}
+
+void qvio_source_open(struct qvio_source* self) {
+	// the first user checks right away, the signal may have changed while nobody polled
+	mutex_lock(&self->lock);
+	if(atomic_inc_return(&self->users) == 1 && self->started)
+		mod_delayed_work(system_wq, &self->work, 0);
+	mutex_unlock(&self->lock);
+}
+
+void qvio_source_close(struct qvio_source* self) {
+	atomic_dec(&self->users);
+}
+
+void qvio_source_irq(struct qvio_source* self, int irq) {
+	if(irq == source_irq && READ_ONCE(self->started)) {
+		atomic_set(&self->refresh, 1);
+		mod_delayed_work(system_wq, &self->work, 0);
+	}
+}
+
+int qvio_source_query(struct qvio_source* self, struct v4l2_dv_timings* timings) {
+	if(! self->started)
+		return -ENODATA;
+
+	return __source_check(self, timings, false);
+}
+
+int qvio_source_g_timings(struct qvio_source* self, struct v4l2_dv_timings* timings) {
+	int err;
+
+	if(! self->started)
+		return -ENODATA;
+
+	// the last signal seen, kept across a signal loss
+	mutex_lock(&self->lock);
+	if(self->timings.bt.width) {
+		*timings = self->timings;
+		err = 0;
+	} else {
+		err = -ENODATA;
+	}
+	mutex_unlock(&self->lock);
+
+	return err;
+}
+
+bool qvio_source_has_signal(struct qvio_source* self) {
+	return READ_ONCE(self->valid);
+}
+
+int qvio_source_g_mcu_table(struct qvio_source* self, struct qvio_mcu_table* table) {
+	int err;
+	struct v4l2_dv_timings timings;
+
+	if(! self->started)
+		return -ENODATA;
+
+	if(table->flags & QVIO_MCU_TABLE_F_REFRESH) {
+		err = __source_check(self, &timings, true);
+		if(err && err != -ENOLINK) {
+			pr_err("__source_check() failed, err=%d\n", err);
+			return err;
+		}
+	}
+
+	mutex_lock(&self->lock);
+	if(self->mcu_valid) {
+		table->sequence = self->mcu_sequence;
+		table->timestamp_ns = self->mcu_timestamp;
+		memcpy(table->header, self->mcu_header, sizeof(table->header));
+		memcpy(table->entry, self->mcu_entry, sizeof(table->entry));
+		memset(table->reserved, 0, sizeof(table->reserved));
+		err = 0;
+	} else {
+		err = -ENODATA;
+	}
+	mutex_unlock(&self->lock);
+
+	return err;
+}
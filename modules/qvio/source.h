@@ -0,0 +1,50 @@
+#ifndef __QVIO_SOURCE_H__
+#define __QVIO_SOURCE_H__
+
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/videodev2.h>
+#include <linux/atomic.h>
+
+#include "uapi/qvio.h"
+
+// input signal of a capture node, detected through the card's MCU
+struct qvio_source {
+	struct mutex lock;
+	struct delayed_work work;
+	bool started;
+	atomic_t users;	// open file handles, the signal is polled only while there are any
+	atomic_t refresh;	// the next check reads the MCU table too
+
+	bool valid;		// a signal is present
+	struct v4l2_dv_timings timings;	// the last signal seen
+	u32 changes;	// V4L2_EVENT_SOURCE_CHANGE raised since start
+
+	// MCU parameter table, refreshed at start, on the user IRQ, on a signal change
+	// and with QVIO_MCU_TABLE_F_REFRESH, never by a plain poll
+	bool mcu_valid;
+	u32 mcu_sequence;
+	u64 mcu_timestamp;
+	u8 mcu_header[QVIO_MCU_HEADER_SIZE];
+	u8 mcu_entry[QVIO_MCU_ENTRY_SIZE];
+};
+
+void qvio_source_init(struct qvio_source* self);
+
+int qvio_source_start(struct qvio_source* self);
+void qvio_source_stop(struct qvio_source* self);
+
+// a file handle of the node, polling runs from the first open to the last close
+void qvio_source_open(struct qvio_source* self);
+void qvio_source_close(struct qvio_source* self);
+
+// user IRQ of the card, a signal change rechecks right away
+void qvio_source_irq(struct qvio_source* self, int irq);
+
+// -ENOLINK without a signal, -ENODATA if the node has no signal detection
+int qvio_source_query(struct qvio_source* self, struct v4l2_dv_timings* timings);
+int qvio_source_g_timings(struct qvio_source* self, struct v4l2_dv_timings* timings);
+bool qvio_source_has_signal(struct qvio_source* self);
+int qvio_source_g_mcu_table(struct qvio_source* self, struct qvio_mcu_table* table);
+
+#endif // __QVIO_SOURCE_H__
@@ -0,0 +1,209 @@
+#define pr_fmt(fmt)     "[" KBUILD_MODNAME "]%s(#%d): " fmt, __func__, __LINE__
+
+#include "user_irq.h"
+#include "device.h"
+#include "libxdma_api.h"
+
+#include <linux/version.h>
+#include <linux/eventfd.h>
+#include <linux/uaccess.h>
+
+static irqreturn_t __user_irq(int irq, void* dev) {
+	struct qvio_user_irq* self = dev;
+	unsigned long flags;
+	bool deliver;
+
+	if(irq < 0 || irq >= QVIO_USER_IRQ_MAX)
+		return IRQ_NONE;
+
+	spin_lock_irqsave(&self->lock, flags);
+	self->count[irq]++;
+	deliver = !!(self->mask & BIT(irq));
+	if(deliver) {
+		self->pending |= BIT(irq);
+
+		if(self->eventfd[irq]) {
+#if KERNEL_VERSION(6, 8, 0) <= LINUX_VERSION_CODE
+			eventfd_signal(self->eventfd[irq]);
+#else
+			eventfd_signal(self->eventfd[irq], 1);
+#endif
+		}
+	}
+	spin_unlock_irqrestore(&self->lock, flags);
+
+	if(deliver)
+		wake_up_interruptible(&self->wq);
+
+	qvio_device_user_irq(self->qdev, irq);
+
+	return IRQ_HANDLED;
+}
+
+int qvio_user_irq_start(struct qvio_user_irq* self, struct qvio_device* qdev, u32 lines) {
+	int err;
+
+	self->qdev = qdev;
+	self->lines = lines & (BIT(min(qdev->user_max, QVIO_USER_IRQ_MAX)) - 1);
+	spin_lock_init(&self->lock);
+	init_waitqueue_head(&self->wq);
+	self->mask = 0;
+	self->pending = 0;
+	memset(self->count, 0, sizeof(self->count));
+	memset(self->eventfd, 0, sizeof(self->eventfd));
+
+	if(! self->lines)
+		return 0;
+
+	err = xdma_user_isr_register(qdev->xdev, self->lines, __user_irq, self);
+	if(err) {
+		pr_err("xdma_user_isr_register() failed, err=%d\n", err);
+		goto err0;
+	}
+
+	return 0;
+
+err0:
+	self->lines = 0;
+	return err;
+}
+
+// safe to call again
+void qvio_user_irq_stop(struct qvio_user_irq* self) {
+	unsigned long flags;
+	int i;
+
+	if(self->lines)
+		xdma_user_isr_register(self->qdev->xdev, self->lines, NULL, NULL);
+
+	spin_lock_irqsave(&self->lock, flags);
+	self->lines = 0;
+	self->mask = 0;
+	spin_unlock_irqrestore(&self->lock, flags);
+
+	for(i = 0; i < QVIO_USER_IRQ_MAX; i++) {
+		if(self->eventfd[i]) {
+			eventfd_ctx_put(self->eventfd[i]);
+			self->eventfd[i] = NULL;
+		}
+	}
+
+	wake_up_interruptible(&self->wq);
+}
+
+__poll_t qvio_user_irq_poll(struct qvio_user_irq* self, struct file *filp, struct poll_table_struct *wait) {
+	poll_wait(filp, &self->wq, wait);
+
+	if(READ_ONCE(self->pending))
+		return EPOLLIN | EPOLLRDNORM;
+
+	return 0;
+}
+
+static long __ioctl_get(struct qvio_user_irq* self, unsigned long arg) {
+	struct qvio_user_irq_events events;
+	unsigned long flags;
+
+	spin_lock_irqsave(&self->lock, flags);
+	events.pending = self->pending;
+	events.mask = self->mask;
+	memcpy(events.count, self->count, sizeof(events.count));
+	self->pending = 0;
+	spin_unlock_irqrestore(&self->lock, flags);
+
+	if(copy_to_user((void __user *)arg, &events, sizeof(events))) {
+		pr_err("copy_to_user() failed\n");
+		return -EFAULT;
+	}
+
+	return 0;
+}
+
+static long __ioctl_s_mask(struct qvio_user_irq* self, unsigned long arg) {
+	u32 mask;
+	unsigned long flags;
+
+	if(get_user(mask, (u32 __user *)arg)) {
+		pr_err("get_user() failed\n");
+		return -EFAULT;
+	}
+
+	if(mask & ~self->lines) {
+		pr_err("unexpected value, mask=0x%X lines=0x%X\n", mask, self->lines);
+		return -EINVAL;
+	}
+
+	spin_lock_irqsave(&self->lock, flags);
+	self->mask = mask;
+	self->pending &= mask;
+	spin_unlock_irqrestore(&self->lock, flags);
+
+	return 0;
+}
+
+static long __ioctl_eventfd(struct qvio_user_irq* self, unsigned long arg) {
+	long ret;
+	struct qvio_user_irq_eventfd args;
+	struct eventfd_ctx* ctx = NULL;
+	struct eventfd_ctx* old;
+	unsigned long flags;
+
+	if(copy_from_user(&args, (void __user *)arg, sizeof(args))) {
+		pr_err("copy_from_user() failed\n");
+		ret = -EFAULT;
+		goto err0;
+	}
+
+	if(args.line >= QVIO_USER_IRQ_MAX || ! (self->lines & BIT(args.line))) {
+		pr_err("unexpected value, args.line=%u lines=0x%X\n", args.line, self->lines);
+		ret = -EINVAL;
+		goto err0;
+	}
+
+	if(args.fd >= 0) {
+		ctx = eventfd_ctx_fdget(args.fd);
+		if(IS_ERR(ctx)) {
+			ret = PTR_ERR(ctx);
+			pr_err("eventfd_ctx_fdget() failed, ret=%ld\n", ret);
+			goto err0;
+		}
+	}
+
+	spin_lock_irqsave(&self->lock, flags);
+	old = self->eventfd[args.line];
+	self->eventfd[args.line] = ctx;
+	spin_unlock_irqrestore(&self->lock, flags);
+
+	if(old)
+		eventfd_ctx_put(old);
+
+	return 0;
+
+err0:
+	return ret;
+}
+
+long qvio_user_irq_ioctl(struct qvio_user_irq* self, unsigned int cmd, unsigned long arg) {
+	long ret;
+
+	switch(cmd) {
+	case QVID_IOC_USER_IRQ_GET:
+		ret = __ioctl_get(self, arg);
+		break;
+
+	case QVID_IOC_USER_IRQ_S_MASK:
+		ret = __ioctl_s_mask(self, arg);
+		break;
+
+	case QVID_IOC_USER_IRQ_EVENTFD:
+		ret = __ioctl_eventfd(self, arg);
+		break;
+
+	default:
+		pr_err("unexpected value, cmd=0x%X\n", cmd);
+		ret = -ENOTTY;
+		break;
+	}
+
+	return ret;
+}
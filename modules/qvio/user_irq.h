@@ -0,0 +1,33 @@
+#ifndef __QVIO_USER_IRQ_H__
+#define __QVIO_USER_IRQ_H__
+
+#include <linux/types.h>
+#include <linux/spinlock_types.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+
+#include "uapi/qvio.h"
+
+struct eventfd_ctx;
+struct qvio_device;
+
+// card user interrupts, counted per line and delivered to the cdev
+struct qvio_user_irq {
+	struct qvio_device* qdev;
+	u32 lines;		// lines this owns, the rest have other handlers
+
+	spinlock_t lock;
+	wait_queue_head_t wq;
+	u32 mask;		// lines delivered to userspace
+	u32 pending;	// delivered lines raised since the last QVID_IOC_USER_IRQ_GET
+	u32 count[QVIO_USER_IRQ_MAX];
+	struct eventfd_ctx* eventfd[QVIO_USER_IRQ_MAX];
+};
+
+int qvio_user_irq_start(struct qvio_user_irq* self, struct qvio_device* qdev, u32 lines);
+void qvio_user_irq_stop(struct qvio_user_irq* self);
+
+__poll_t qvio_user_irq_poll(struct qvio_user_irq* self, struct file *filp, struct poll_table_struct *wait);
+long qvio_user_irq_ioctl(struct qvio_user_irq* self, unsigned int cmd, unsigned long arg);
+
+#endif // __QVIO_USER_IRQ_H__
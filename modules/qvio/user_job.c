@@ -2,18 +2,20 @@
 
 #include "user_job.h"
 
+#include <linux/module.h>
 #include <linux/compat.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+
+static int user_job_dispatch = QVIO_USER_JOB_DISPATCH_RR;
+module_param(user_job_dispatch, int, 0644);
+MODULE_PARM_DESC(user_job_dispatch, "Buffer jobs to user-job consumers, 0 - round-robin (default), 1 - by buffer index");
 
 struct __user_job_entry {
 	struct list_head node;
 	struct qvio_user_job user_job;
 };
 
-struct __user_job_done_entry {
-	struct list_head node;
-	struct qvio_user_job_done user_job_done;
-};
-
 int __user_job_entry_new(struct __user_job_entry** user_job_entry) {
 	int err;
 
@@ -32,58 +34,606 @@ err0:
 	return err;
 }
 
-int __user_job_done_entry_new(struct __user_job_done_entry** user_job_done_entry) {
+static void __latency_add(struct qvio_user_job_latency* latency, ktime_t delta) {
+	s64 us = ktime_to_us(delta);
+	int bucket;
+
+	if(us < 0)
+		us = 0;
+	if(us > U32_MAX)
+		us = U32_MAX;
+
+	if(! latency->count || us < latency->min_us)
+		latency->min_us = (__u32)us;
+	if(us > latency->max_us)
+		latency->max_us = (__u32)us;
+	latency->count++;
+	latency->sum_us += us;
+
+	bucket = (us > 1) ? fls64(us) - 1 : 0;
+	if(bucket >= QVIO_USER_JOB_STATS_BUCKETS)
+		bucket = QVIO_USER_JOB_STATS_BUCKETS - 1;
+	latency->hist[bucket]++;
+}
+
+// t_end is when the driver is through with the done, fn returned or the waiter woke up
+static void __stats_record(struct qvio_user_job_ctrl* self, __u16 id,
+	ktime_t t_post, ktime_t t_get, ktime_t t_done, ktime_t t_end) {
+	struct qvio_user_job_stats_id* stats;
+	unsigned long flags;
+
+	if(id >= QVIO_USER_JOB_STATS_IDS)
+		return;
+
+	spin_lock_irqsave(&self->stats_lock, flags);
+	stats = &self->stats[id];
+	if(t_get) {
+		__latency_add(&stats->wait, ktime_sub(t_get, t_post));
+		__latency_add(&stats->daemon, ktime_sub(t_done, t_get));
+	}
+	__latency_add(&stats->done, ktime_sub(t_end, t_done));
+	__latency_add(&stats->total, ktime_sub(t_end, t_post));
+	spin_unlock_irqrestore(&self->stats_lock, flags);
+}
+
+static void __stats_cancelled(struct qvio_user_job_ctrl* self, __u16 id) {
+	unsigned long flags;
+
+	if(id >= QVIO_USER_JOB_STATS_IDS)
+		return;
+
+	spin_lock_irqsave(&self->stats_lock, flags);
+	self->stats[id].cancelled++;
+	spin_unlock_irqrestore(&self->stats_lock, flags);
+}
+
+static u32 __ring_count(struct qvio_user_job_ring* ring) {
+	return smp_load_acquire(&ring->head) - READ_ONCE(ring->tail);
+}
+
+// the worker kicks only while the driver blocks on one of its dones, the rest are reaped without it, done_lock held
+static void __consumer_flags_update(struct qvio_user_job_consumer* consumer) {
+	if(consumer->rings) {
+		WRITE_ONCE(consumer->rings->done.flags, consumer->wait_num ? QVIO_USER_JOB_RING_F_WAIT : 0);
+		smp_mb();
+	}
+}
+
+static void __pending_attach_locked(struct qvio_user_job_pending* pending, struct qvio_user_job_consumer* consumer) {
+	pending->consumer = consumer;
+	consumer->pending_num++;
+	if(pending->waiting) {
+		consumer->wait_num++;
+		__consumer_flags_update(consumer);
+	}
+}
+
+static void __pending_detach_locked(struct qvio_user_job_pending* pending) {
+	if(pending->consumer) {
+		pending->consumer->pending_num--;
+		if(pending->waiting) {
+			pending->consumer->wait_num--;
+			__consumer_flags_update(pending->consumer);
+		}
+		pending->consumer = NULL;
+	}
+}
+
+// the driver blocks on the job's done, or stops doing so, done_lock held
+static void __pending_wait_locked(struct qvio_user_job_pending* pending, bool waiting) {
+	if(pending->waiting == waiting)
+		return;
+
+	pending->waiting = waiting;
+	if(pending->consumer) {
+		pending->consumer->wait_num += waiting ? 1 : -1;
+		__consumer_flags_update(pending->consumer);
+	}
+}
+
+static struct qvio_user_job_pending* __pending_find_locked(struct qvio_user_job_ctrl* self, __u16 sequence) {
+	int i;
+
+	for(i = 0;i < QVIO_USER_JOB_MAX_PENDING;i++) {
+		if(self->pending[i].used && ! self->pending[i].completed &&
+			self->pending[i].sequence == sequence) {
+			return &self->pending[i];
+		}
+	}
+
+	return NULL;
+}
+
+// reserve a completion slot and the job sequence before posting, the done can't race ahead
+static struct qvio_user_job_pending* __pending_get(struct qvio_user_job_ctrl* self, struct qvio_user_job* user_job,
+	bool async, void* user, qvio_user_job_done_handler fn) {
+	struct qvio_user_job_pending* pending = NULL;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&self->done_lock, flags);
+	for(i = 0;i < QVIO_USER_JOB_MAX_PENDING;i++) {
+		if(! self->pending[i].used) {
+			pending = &self->pending[i];
+			break;
+		}
+	}
+
+	if(pending) {
+		user_job->sequence = (__u16)atomic_inc_return(&self->sequence);
+
+		pending->used = true;
+		pending->completed = false;
+		pending->cancelled = false;
+		pending->running = false;
+		pending->async = async;
+		pending->waiting = false;
+		pending->id = user_job->id;
+		pending->sequence = user_job->sequence;
+		pending->user = user;
+		pending->fn = fn;
+		pending->consumer = NULL;
+		pending->t_post = ktime_get();
+		pending->t_get = 0;
+		pending->t_done = 0;
+		self->pending_num++;
+	}
+	spin_unlock_irqrestore(&self->done_lock, flags);
+
+	return pending;
+}
+
+static void __pending_put_locked(struct qvio_user_job_ctrl* self, struct qvio_user_job_pending* pending) {
+	__pending_detach_locked(pending);
+	pending->used = false;
+	self->pending_num--;
+}
+
+static void __pending_put(struct qvio_user_job_ctrl* self, struct qvio_user_job_pending* pending) {
+	unsigned long flags;
+
+	spin_lock_irqsave(&self->done_lock, flags);
+	__pending_put_locked(self, pending);
+	spin_unlock_irqrestore(&self->done_lock, flags);
+}
+
+// hand one user-job-done to its posted job, matched by sequence and owned by the consumer it was given to
+static int __user_job_complete(struct qvio_user_job_ctrl* self, struct qvio_user_job_consumer* consumer,
+	struct qvio_user_job_done* user_job_done) {
+	struct qvio_user_job_pending* pending;
+	void* user;
+	qvio_user_job_done_handler fn;
+	unsigned long flags;
+	ktime_t t_done = ktime_get();
+	ktime_t t_post, t_get;
+	__u16 id;
+
+#if 0 // DEBUG
+	pr_info("-user_job_done(%d, %d)\n",
+		(int)user_job_done->id,
+		(int)user_job_done->sequence);
+#endif
+
+	spin_lock_irqsave(&self->done_lock, flags);
+	pending = __pending_find_locked(self, user_job_done->sequence);
+	if(! pending) {
+		spin_unlock_irqrestore(&self->done_lock, flags);
+
+		// late done of a cancelled or abandoned job
+		pr_warn_ratelimited("unexpected user_job_done={%d %d}\n",
+			(int)user_job_done->id,
+			(int)user_job_done->sequence);
+		return 0;
+	}
+
+	if(pending->consumer != consumer) {
+		spin_unlock_irqrestore(&self->done_lock, flags);
+
+		pr_err("unexpected consumer, user_job_done={%d %d} consumer=%p != %p\n",
+			(int)user_job_done->id,
+			(int)user_job_done->sequence,
+			consumer, pending->consumer);
+		return -EPERM;
+	}
+
+	if(pending->id != user_job_done->id) {
+		pr_warn("unexpected value, id=%d != %d, sequence=%d\n",
+			(int)user_job_done->id, (int)pending->id, (int)user_job_done->sequence);
+	}
+
+	if(pending->async) {
+		user = pending->user;
+		fn = pending->fn;
+		id = pending->id;
+		t_post = pending->t_post;
+		t_get = pending->t_get;
+		__pending_put_locked(self, pending);
+		spin_unlock_irqrestore(&self->done_lock, flags);
+
+		if(fn)
+			fn(user, user_job_done);
+
+		__stats_record(self, id, t_post, t_get, t_done, ktime_get());
+
+		return 0;
+	}
+
+	// the waiter stays until fn has run
+	__pending_detach_locked(pending);
+	pending->t_done = t_done;
+	pending->running = true;
+	user = pending->user;
+	fn = pending->fn;
+	spin_unlock_irqrestore(&self->done_lock, flags);
+
+	if(fn)
+		fn(user, user_job_done);
+
+	spin_lock_irqsave(&self->done_lock, flags);
+	pending->completed = true;
+	spin_unlock_irqrestore(&self->done_lock, flags);
+
+	wake_up_interruptible(&self->done_wq);
+
+	return 0;
+}
+
+// the next done off the ring, 1 if taken, head is written by the worker and not trusted, done_lock held,
+// outside the worker's own context a synchronous job's done stays for it, fn may need the worker's fds
+static int __consumer_ring_take_locked(struct qvio_user_job_consumer* consumer, bool worker,
+	struct qvio_user_job_done* user_job_done) {
+	struct qvio_user_job_ring* ring = &consumer->rings->done;
+	struct qvio_user_job_pending* pending;
+	u32 tail, count;
+
+	count = __ring_count(ring);
+	if(count == 0)
+		return 0;
+
+	if(count > QVIO_USER_JOB_RING_SIZE) {
+		pr_warn_ratelimited("unexpected value, done ring head=%u tail=%u\n",
+			READ_ONCE(ring->head), READ_ONCE(ring->tail));
+		return -EINVAL;
+	}
+
+	tail = ring->tail;
+	*user_job_done = consumer->rings->dones[tail & (QVIO_USER_JOB_RING_SIZE - 1)];
+	if(! worker) {
+		pending = __pending_find_locked(consumer->ctrl, user_job_done->sequence);
+		if(pending && ! pending->async)
+			return 0;
+	}
+	smp_store_release(&ring->tail, tail + 1);
+
+	return 1;
+}
+
+// at most one ring's worth per call
+static int __consumer_ring_reap(struct qvio_user_job_consumer* consumer, bool worker) {
+	struct qvio_user_job_ctrl* self = consumer->ctrl;
+	struct qvio_user_job_done user_job_done;
+	unsigned long flags;
 	int err;
+	int i;
 
-	*user_job_done_entry = kzalloc(sizeof(struct __user_job_done_entry), GFP_KERNEL);
-	if(! *user_job_done_entry) {
-		pr_err("out of memory\n");
+	if(! READ_ONCE(consumer->ring_mode))
+		return 0;
 
-		err = ENOMEM;
-		goto err0;
+	for(i = 0;i < QVIO_USER_JOB_RING_SIZE;i++) {
+		spin_lock_irqsave(&self->done_lock, flags);
+		err = __consumer_ring_take_locked(consumer, worker, &user_job_done);
+		spin_unlock_irqrestore(&self->done_lock, flags);
+		if(err <= 0)
+			return err;
+
+		__user_job_complete(self, consumer, &user_job_done);
 	}
-	INIT_LIST_HEAD(&(*user_job_done_entry)->node);
 
 	return 0;
+}
 
-err0:
-	return err;
+void qvio_user_job_reap(struct qvio_user_job_ctrl* self) {
+	struct qvio_user_job_consumer* consumer;
+	struct qvio_user_job_consumer* taken;
+	struct qvio_user_job_done user_job_done;
+	unsigned long flags;
+	int i;
+
+	if(! self->enable)
+		return;
+
+	// one done at a time, the consumer may go away once job_list_lock is dropped and is only compared
+	for(i = 0;i < QVIO_USER_JOB_RING_SIZE;i++) {
+		taken = NULL;
+
+		spin_lock_irqsave(&self->job_list_lock, flags);
+		spin_lock(&self->done_lock);
+		list_for_each_entry(consumer, &self->consumers, node) {
+			if(consumer->ring_mode && __consumer_ring_take_locked(consumer, false, &user_job_done) > 0) {
+				taken = consumer;
+				break;
+			}
+		}
+		spin_unlock(&self->done_lock);
+		spin_unlock_irqrestore(&self->job_list_lock, flags);
+
+		if(! taken)
+			break;
+
+		__user_job_complete(self, taken, &user_job_done);
+	}
+}
+
+// job_list_lock held
+static struct qvio_user_job_consumer* __consumer_pick(struct qvio_user_job_ctrl* self, struct qvio_user_job* user_job) {
+	struct qvio_user_job_consumer* consumer;
+	unsigned int n;
+
+	if(! self->consumer_num)
+		return NULL;
+
+	switch(user_job->id) {
+	case QVIO_USER_JOB_ID_BUF_INIT:
+		n = (unsigned int)user_job->u.buf_init.index;
+		break;
+
+	case QVIO_USER_JOB_ID_BUF_CLEANUP:
+		n = (unsigned int)user_job->u.buf_cleanup.index;
+		break;
+
+	case QVIO_USER_JOB_ID_BUF_DONE:
+		n = (unsigned int)user_job->u.buf_done.index;
+		break;
+
+	default:
+		// session jobs keep their order on the first consumer
+		return list_first_entry(&self->consumers, struct qvio_user_job_consumer, node);
+	}
+
+	if(self->dispatch != QVIO_USER_JOB_DISPATCH_INDEX)
+		n = self->consumer_next;
+	n %= self->consumer_num;
+
+	list_for_each_entry(consumer, &self->consumers, node) {
+		if(n-- == 0)
+			break;
+	}
+
+	return consumer;
+}
+
+struct qvio_user_job_consumer* qvio_user_job_consumer_new(struct qvio_user_job_ctrl* self) {
+	struct qvio_user_job_consumer* consumer;
+	struct __user_job_entry *user_job_entry;
+	struct qvio_user_job_pending* pending;
+	unsigned long flags;
+
+	consumer = kzalloc(sizeof(struct qvio_user_job_consumer), GFP_KERNEL);
+	if(! consumer) {
+		pr_err("out of memory\n");
+		return NULL;
+	}
+	INIT_LIST_HEAD(&consumer->node);
+	consumer->ctrl = self;
+	init_waitqueue_head(&consumer->job_wq);
+	INIT_LIST_HEAD(&consumer->job_list);
+
+	spin_lock_irqsave(&self->job_list_lock, flags);
+	list_add_tail(&consumer->node, &self->consumers);
+	self->consumer_num++;
+
+	// the first worker takes over what was posted before anyone attached
+	if(! list_empty(&self->job_list)) {
+		spin_lock(&self->done_lock);
+		list_for_each_entry(user_job_entry, &self->job_list, node) {
+			pending = __pending_find_locked(self, user_job_entry->user_job.sequence);
+			if(pending)
+				__pending_attach_locked(pending, consumer);
+		}
+		spin_unlock(&self->done_lock);
+
+		list_splice_tail_init(&self->job_list, &consumer->job_list);
+	}
+	spin_unlock_irqrestore(&self->job_list_lock, flags);
+
+	pr_info("consumer=%p consumer_num=%d\n", consumer, self->consumer_num);
+
+	return consumer;
+}
+
+void qvio_user_job_consumer_free(struct qvio_user_job_consumer* consumer) {
+	struct qvio_user_job_ctrl* self = consumer->ctrl;
+	struct __user_job_entry *user_job_entry, *tmp;
+	struct qvio_user_job_pending* pending;
+	void* user;
+	qvio_user_job_done_handler fn;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&self->job_list_lock, flags);
+	list_del(&consumer->node);
+	self->consumer_num--;
+	spin_unlock_irqrestore(&self->job_list_lock, flags);
+
+	pr_info("consumer=%p pending_num=%d\n", consumer, consumer->pending_num);
+
+	// nothing reaches this consumer any more, what it still holds is cancelled
+	for(i = 0;i < QVIO_USER_JOB_MAX_PENDING;i++) {
+		pending = &self->pending[i];
+
+		spin_lock_irqsave(&self->done_lock, flags);
+		if(! pending->used || pending->completed || pending->consumer != consumer) {
+			spin_unlock_irqrestore(&self->done_lock, flags);
+			continue;
+		}
+
+		__stats_cancelled(self, pending->id);
+
+		if(! pending->async) {
+			__pending_detach_locked(pending);
+			pending->running = true;
+			user = pending->user;
+			fn = pending->fn;
+			spin_unlock_irqrestore(&self->done_lock, flags);
+
+			if(fn)
+				fn(user, NULL);
+
+			spin_lock_irqsave(&self->done_lock, flags);
+			pending->cancelled = true;
+			pending->completed = true;
+			spin_unlock_irqrestore(&self->done_lock, flags);
+
+			wake_up_interruptible(&self->done_wq);
+			continue;
+		}
+
+		user = pending->user;
+		fn = pending->fn;
+		__pending_put_locked(self, pending);
+		spin_unlock_irqrestore(&self->done_lock, flags);
+
+		if(fn)
+			fn(user, NULL);
+	}
+
+	list_for_each_entry_safe(user_job_entry, tmp, &consumer->job_list, node) {
+		list_del(&user_job_entry->node);
+		kfree(user_job_entry);
+	}
+
+	if(consumer->rings)
+		vfree(consumer->rings);
+
+	kfree(consumer);
 }
 
 static int __file_release(struct inode *inode, struct file *filep) {
-	struct qvio_user_job_ctrl* self = filep->private_data;
+	struct qvio_user_job_consumer* consumer = filep->private_data;
+
+	pr_info("consumer=%p\n", consumer);
+
+	// what the worker answered before closing still completes, its synchronous jobs are cancelled
+	__consumer_ring_reap(consumer, false);
+	qvio_user_job_consumer_free(consumer);
+
+	return 0;
+}
+
+static int __file_mmap(struct file *filep, struct vm_area_struct *vma) {
+	int err;
+	struct qvio_user_job_consumer* consumer = filep->private_data;
+	struct qvio_user_job_ctrl* self = consumer->ctrl;
+	struct __user_job_entry *user_job_entry, *tmp;
+	struct qvio_user_job_ring* ring;
+	struct qvio_user_job_rings* rings = NULL;
+	unsigned long size = vma->vm_end - vma->vm_start;
+	unsigned long flags;
+
+	pr_info("consumer=%p size=%lu\n", consumer, size);
+
+	if(vma->vm_pgoff != 0 || size > PAGE_ALIGN(sizeof(struct qvio_user_job_rings))) {
+		pr_err("unexpected value, vm_pgoff=%lu size=%lu\n", vma->vm_pgoff, size);
+		err = -EINVAL;
+		goto err0;
+	}
+
+	// threads sharing the fd may mmap concurrently, one allocation wins and stays until the fd is released
+	if(! READ_ONCE(consumer->rings)) {
+		rings = vmalloc_user(sizeof(struct qvio_user_job_rings));
+		if(! rings) {
+			pr_err("vmalloc_user() failed\n");
+			err = -ENOMEM;
+			goto err0;
+		}
+
+		spin_lock_irqsave(&self->job_list_lock, flags);
+		if(! consumer->rings) {
+			consumer->rings = rings;
+			rings = NULL;
+		}
+		spin_unlock_irqrestore(&self->job_list_lock, flags);
+
+		vfree(rings);
+	}
 
-	pr_info("self=%p\n", self);
+	err = remap_vmalloc_range(vma, consumer->rings, 0);
+	if(err) {
+		pr_err("remap_vmalloc_range() failed, err=%d\n", err);
+		goto err0;
+	}
+
+	spin_lock_irqsave(&self->job_list_lock, flags);
+	if(! consumer->ring_mode) {
+		memset(&consumer->rings->job, 0, sizeof(struct qvio_user_job_ring));
+		memset(&consumer->rings->done, 0, sizeof(struct qvio_user_job_ring));
+
+		// jobs queued before the switch move over to the ring
+		ring = &consumer->rings->job;
+		list_for_each_entry_safe(user_job_entry, tmp, &consumer->job_list, node) {
+			if(ring->head >= QVIO_USER_JOB_RING_SIZE)
+				break;
+
+			consumer->rings->jobs[ring->head++] = user_job_entry->user_job;
+			list_del(&user_job_entry->node);
+			kfree(user_job_entry);
+		}
+
+		spin_lock(&self->done_lock);
+		__consumer_flags_update(consumer);
+		spin_unlock(&self->done_lock);
+
+		WRITE_ONCE(consumer->ring_mode, true);
+	}
+	spin_unlock_irqrestore(&self->job_list_lock, flags);
 
 	return 0;
+
+err0:
+	return err;
 }
 
 static __poll_t __file_poll(struct file *filep, struct poll_table_struct *wait) {
-	struct qvio_user_job_ctrl* self = filep->private_data;
+	struct qvio_user_job_consumer* consumer = filep->private_data;
+
+	poll_wait(filep, &consumer->job_wq, wait);
 
-	poll_wait(filep, &self->job_wq, wait);
+	// the worker polls after each drained batch, its dones need no kick
+	__consumer_ring_reap(consumer, true);
 
-	if(!list_empty(&self->job_list))
+	if(!list_empty(&consumer->job_list))
+		return EPOLLIN | EPOLLRDNORM;
+
+	if(consumer->ring_mode && __ring_count(&consumer->rings->job) > 0)
 		return EPOLLIN | EPOLLRDNORM;
 
 	return 0;
 }
 
-static long __ioctl_user_job_get(struct qvio_user_job_ctrl* self, unsigned long arg) {
+static long __ioctl_user_job_get(struct qvio_user_job_consumer* consumer, unsigned long arg) {
 	long ret;
+	struct qvio_user_job_ctrl* self = consumer->ctrl;
 	struct __user_job_entry *user_job_entry;
+	struct qvio_user_job_pending* pending;
 	unsigned long flags;
 
-	if(list_empty(&self->job_list)) {
-		pr_err("unexpected value, self->job_list is empty\n");
+	// threads sharing one fd may race for the same job
+	spin_lock_irqsave(&self->job_list_lock, flags);
+	if(list_empty(&consumer->job_list)) {
+		spin_unlock_irqrestore(&self->job_list_lock, flags);
 
-		ret = -EFAULT;
+		ret = -EAGAIN;
 		goto err0;
 	}
 
-	spin_lock_irqsave(&self->job_list_lock, flags);
-	user_job_entry = list_first_entry(&self->job_list, struct __user_job_entry, node);
+	user_job_entry = list_first_entry(&consumer->job_list, struct __user_job_entry, node);
 	list_del(&user_job_entry->node);
+
+	spin_lock(&self->done_lock);
+	pending = __pending_find_locked(self, user_job_entry->user_job.sequence);
+	if(pending)
+		pending->t_get = ktime_get();
+	spin_unlock(&self->done_lock);
 	spin_unlock_irqrestore(&self->job_list_lock, flags);
 
 #if 0 // DEBUG
@@ -111,25 +661,52 @@ err0:
 	return ret;
 }
 
-static long __ioctl_user_job_done(struct qvio_user_job_ctrl* self, unsigned long arg) {
-	int err;
+static long __ioctl_user_job_done(struct qvio_user_job_consumer* consumer, unsigned long arg) {
 	long ret;
-	struct __user_job_done_entry *user_job_done_entry;
-	unsigned long flags;
+	struct qvio_user_job_done user_job_done;
 
 #if 0 // DEBUG
 	pr_info("\n");
 #endif
 
-	err = __user_job_done_entry_new(&user_job_done_entry);
-	if(err) {
-		pr_err("__user_job_done_entry_new() failed, err=%d\n", err);
+	ret = copy_from_user(&user_job_done, (void __user *)arg, sizeof(struct qvio_user_job_done));
+	if (ret != 0) {
+		pr_err("copy_from_user() failed, err=%d\n", (int)ret);
+
+		ret = -EFAULT;
+		goto err0;
+	}
+
+#if 0 // DEBUG
+	pr_info("+user_job_done(%d, %d)\n",
+		(int)user_job_done.id,
+		(int)user_job_done.sequence);
+#endif
+
+	ret = __user_job_complete(consumer->ctrl, consumer, &user_job_done);
+
+	return ret;
+
+err0:
+	return ret;
+}
+
+static long __ioctl_user_job_stats(struct qvio_user_job_consumer* consumer, unsigned long arg) {
+	long ret;
+	struct qvio_user_job_ctrl* self = consumer->ctrl;
+	struct qvio_user_job_stats* stats;
+	unsigned long flags;
 
-		ret = -err;
+	// too large for the stack
+	stats = kzalloc(sizeof(struct qvio_user_job_stats), GFP_KERNEL);
+	if(! stats) {
+		pr_err("kzalloc() failed\n");
+
+		ret = -ENOMEM;
 		goto err0;
 	}
 
-	ret = copy_from_user(&user_job_done_entry->user_job_done, (void __user *)arg, sizeof(struct qvio_user_job_done));
+	ret = copy_from_user(&stats->flags, (void __user *)arg, sizeof(stats->flags));
 	if (ret != 0) {
 		pr_err("copy_from_user() failed, err=%d\n", (int)ret);
 
@@ -137,39 +714,50 @@ static long __ioctl_user_job_done(struct qvio_user_job_ctrl* self, unsigned long
 		goto err1;
 	}
 
-#if 0 // DEBUG
-	pr_info("+user_job_done(%d, %d)\n",
-		(int)user_job_done_entry->user_job_done.id,
-		(int)user_job_done_entry->user_job_done.sequence);
-#endif
+	spin_lock_irqsave(&self->stats_lock, flags);
+	memcpy(stats->id, self->stats, sizeof(stats->id));
+	if(stats->flags & QVIO_USER_JOB_STATS_F_RESET)
+		memset(self->stats, 0, sizeof(self->stats));
+	spin_unlock_irqrestore(&self->stats_lock, flags);
 
-	spin_lock_irqsave(&self->done_list_lock, flags);
-	list_add_tail(&user_job_done_entry->node, &self->done_list);
-	spin_unlock_irqrestore(&self->done_list_lock, flags);
+	ret = copy_to_user((void __user *)arg, stats, sizeof(struct qvio_user_job_stats));
+	if (ret != 0) {
+		pr_err("copy_to_user() failed, err=%d\n", (int)ret);
 
-	wake_up_interruptible(&self->done_wq);
+		ret = -EFAULT;
+		goto err1;
+	}
 
+	kfree(stats);
 	ret = 0;
 
 	return ret;
 
 err1:
-	kfree(user_job_done_entry);
+	kfree(stats);
 err0:
 	return ret;
 }
 
 static long __file_ioctl(struct file *filep, unsigned int cmd, unsigned long arg) {
 	long ret;
-	struct qvio_user_job_ctrl* self = filep->private_data;
+	struct qvio_user_job_consumer* consumer = filep->private_data;
 
 	switch (cmd) {
 	case QVID_IOC_USER_JOB_GET:
-		ret = __ioctl_user_job_get(self, arg);
+		ret = __ioctl_user_job_get(consumer, arg);
 		break;
 
 	case QVID_IOC_USER_JOB_DONE:
-		ret = __ioctl_user_job_done(self, arg);
+		ret = __ioctl_user_job_done(consumer, arg);
+		break;
+
+	case QVID_IOC_USER_JOB_KICK:
+		ret = __consumer_ring_reap(consumer, true);
+		break;
+
+	case QVID_IOC_USER_JOB_STATS:
+		ret = __ioctl_user_job_stats(consumer, arg);
 		break;
 
 	default:
@@ -192,6 +780,7 @@ static const struct file_operations __fileops = {
 	.owner = THIS_MODULE,
 	.release = __file_release,
 	.poll = __file_poll,
+	.mmap = __file_mmap,
 	.llseek = noop_llseek,
 	.unlocked_ioctl = __file_ioctl,
 #ifdef CONFIG_COMPAT
@@ -205,20 +794,26 @@ void qvio_user_job_start(struct qvio_user_job_ctrl* self) {
 	self->enable = true;
 	atomic_set(&self->sequence, 0);
 
-	init_waitqueue_head(&self->job_wq);
 	spin_lock_init(&self->job_list_lock);
 	INIT_LIST_HEAD(&self->job_list);
+	INIT_LIST_HEAD(&self->consumers);
+	self->consumer_num = 0;
+	self->consumer_next = 0;
+	self->dispatch = user_job_dispatch;
 
 	init_waitqueue_head(&self->done_wq);
-	spin_lock_init(&self->done_list_lock);
-	INIT_LIST_HEAD(&self->done_list);
+	spin_lock_init(&self->done_lock);
+	memset(self->pending, 0, sizeof(self->pending));
+	self->pending_num = 0;
+
+	spin_lock_init(&self->stats_lock);
+	memset(self->stats, 0, sizeof(self->stats));
 
 	self->ctrl_fops = &__fileops;
 }
 
 void qvio_user_job_stop(struct qvio_user_job_ctrl* self) {
-	struct __user_job_entry *user_job_entry;
-	struct __user_job_done_entry *user_job_done_entry;
+	struct __user_job_entry *user_job_entry, *tmp;
 
 	pr_info("\n");
 
@@ -226,7 +821,7 @@ void qvio_user_job_stop(struct qvio_user_job_ctrl* self) {
 		pr_warn("self->job_list is not empty\n");
 
 #if 1
-		list_for_each_entry(user_job_entry, &self->job_list, node) {
+		list_for_each_entry_safe(user_job_entry, tmp, &self->job_list, node) {
 			list_del(&user_job_entry->node);
 
 			pr_warn("user_job_entry->user_job={%d %d}\n",
@@ -238,108 +833,185 @@ void qvio_user_job_stop(struct qvio_user_job_ctrl* self) {
 #endif
 	}
 
-	if(! list_empty(&self->done_list)) {
-		pr_warn("self->done_list is not empty\n");
-
-#if 1
-		list_for_each_entry(user_job_done_entry, &self->done_list, node) {
-			list_del(&user_job_done_entry->node);
-
-			pr_warn("user_job_done_entry->user_job_done={%d %d}\n",
-				(int)user_job_done_entry->user_job_done.id,
-				(int)user_job_done_entry->user_job_done.sequence);
+	if(self->consumer_num) {
+		pr_warn("self->consumer_num=%d\n", self->consumer_num);
+	}
 
-			kfree(user_job_done_entry);
-		}
-#endif
+	if(self->pending_num) {
+		pr_warn("self->pending_num=%d\n", self->pending_num);
 	}
 }
 
-static void __do_user_job(struct qvio_user_job_ctrl* self, struct __user_job_entry* user_job_entry) {
+static int __do_user_job(struct qvio_user_job_ctrl* self, struct qvio_user_job_pending* pending, struct qvio_user_job* user_job) {
+	int err;
 	unsigned long flags;
+	struct __user_job_entry* user_job_entry;
+	struct qvio_user_job_consumer* consumer;
+	struct qvio_user_job_ring* ring;
+	u32 head, tail;
 
 #if 0 // DEBUG
 	pr_info("+user_job(%d, %d)\n",
-		(int)user_job_entry->user_job.id,
-		(int)user_job_entry->user_job.sequence);
+		(int)user_job->id,
+		(int)user_job->sequence);
 #endif
 
+	err = __user_job_entry_new(&user_job_entry);
+	if(err) {
+		pr_err("__user_job_entry_new() failed, err=%d\n", err);
+		goto err0;
+	}
+	user_job_entry->user_job = *user_job;
+
 	spin_lock_irqsave(&self->job_list_lock, flags);
-	list_add_tail(&user_job_entry->node, &self->job_list);
+	consumer = __consumer_pick(self, user_job);
+	if(! consumer) {
+		// held until the first worker attaches
+		list_add_tail(&user_job_entry->node, &self->job_list);
+		spin_unlock_irqrestore(&self->job_list_lock, flags);
+
+		return 0;
+	}
+
+	if(consumer->ring_mode) {
+		ring = &consumer->rings->job;
+		head = ring->head;
+		tail = smp_load_acquire(&ring->tail);
+		if(head - tail >= QVIO_USER_JOB_RING_SIZE) {
+			spin_unlock_irqrestore(&self->job_list_lock, flags);
+			pr_err_ratelimited("job ring is full, head=%u tail=%u\n", head, tail);
+			err = -ENOSPC;
+			goto err1;
+		}
+
+		spin_lock(&self->done_lock);
+		__pending_attach_locked(pending, consumer);
+		spin_unlock(&self->done_lock);
+
+		consumer->rings->jobs[head & (QVIO_USER_JOB_RING_SIZE - 1)] = *user_job;
+		smp_store_release(&ring->head, head + 1);
+		self->consumer_next++;
+		spin_unlock_irqrestore(&self->job_list_lock, flags);
+
+		kfree(user_job_entry);
+
+		// the worker only sleeps in poll() on an empty ring
+		if(head == tail)
+			wake_up_interruptible(&consumer->job_wq);
+
+		return 0;
+	}
+
+	spin_lock(&self->done_lock);
+	__pending_attach_locked(pending, consumer);
+	spin_unlock(&self->done_lock);
+
+	list_add_tail(&user_job_entry->node, &consumer->job_list);
+	self->consumer_next++;
 	spin_unlock_irqrestore(&self->job_list_lock, flags);
 
-	wake_up_interruptible(&self->job_wq);
+	wake_up_interruptible(&consumer->job_wq);
+
+	return 0;
+
+err1:
+	kfree(user_job_entry);
+err0:
+	return err;
 }
 
-static int __wait_for_user_job_done(struct qvio_user_job_ctrl* self, void* user, qvio_user_job_done_handler fn) {
+static int __wait_for_user_job_done(struct qvio_user_job_ctrl* self, struct qvio_user_job_pending* pending) {
 	int err;
 	unsigned long flags;
-	struct __user_job_done_entry* user_job_done_entry;
+	bool cancelled;
+	ktime_t t_post, t_get, t_done;
+	__u16 id;
 
 #if 0 // DEBUG
 	pr_info("\n");
 #endif
 
-	// wait for user-job-done
-	err = wait_event_interruptible(self->done_wq, !list_empty(&self->done_list));
+	// the worker kicks while the driver blocks here, fn runs in its context
+	spin_lock_irqsave(&self->done_lock, flags);
+	__pending_wait_locked(pending, true);
+	spin_unlock_irqrestore(&self->done_lock, flags);
+
+	err = wait_event_interruptible(self->done_wq, READ_ONCE(pending->completed));
+
+	spin_lock_irqsave(&self->done_lock, flags);
+	__pending_wait_locked(pending, false);
+	spin_unlock_irqrestore(&self->done_lock, flags);
+
 	if(err != 0) {
 		pr_err("wait_event_interruptible() failed, err=%d\n", err);
 		goto err0;
 	}
 
-#if 0 // DEBUG
-	pr_info("\n");
-#endif
+	spin_lock_irqsave(&self->done_lock, flags);
+	cancelled = pending->cancelled;
+	id = pending->id;
+	t_post = pending->t_post;
+	t_get = pending->t_get;
+	t_done = pending->t_done;
+	__pending_put_locked(self, pending);
+	spin_unlock_irqrestore(&self->done_lock, flags);
 
-	if(list_empty(&self->done_list)) {
-		pr_err("self->done_list is empty\n");
-		err = EFAULT;
-		goto err0;
-	}
+	// the worker went away with this job
+	if(cancelled)
+		return -ECONNRESET;
 
-	spin_lock_irqsave(&self->done_list_lock, flags);
-	user_job_done_entry = list_first_entry(&self->done_list, struct __user_job_done_entry, node);
-	list_del(&user_job_done_entry->node);
-	spin_unlock_irqrestore(&self->done_list_lock, flags);
+	__stats_record(self, id, t_post, t_get, t_done, ktime_get());
 
-#if 0 // DEBUG
-	pr_info("-user_job_done(%d, %d)\n",
-		(int)user_job_done_entry->user_job_done.id,
-		(int)user_job_done_entry->user_job_done.sequence);
-#endif
+	return 0;
 
-	if(fn) {
-		fn(user, &user_job_done_entry->user_job_done);
+err0:
+	spin_lock_irqsave(&self->done_lock, flags);
+	if(pending->running && ! pending->completed) {
+		// fn may still use the caller's stack
+		spin_unlock_irqrestore(&self->done_lock, flags);
+		wait_event(self->done_wq, READ_ONCE(pending->completed));
+		spin_lock_irqsave(&self->done_lock, flags);
 	}
-	kfree(user_job_done_entry);
 
-	return 0;
+	// nobody waits any more, a late done just releases the slot
+	if(pending->completed) {
+		__pending_put_locked(self, pending);
+	} else {
+		pending->async = true;
+		pending->fn = NULL;
+	}
+	spin_unlock_irqrestore(&self->done_lock, flags);
 
-err0:
 	return err;
 }
 
 int qvio_user_job_s_fmt(struct qvio_user_job_ctrl* self, struct v4l2_format *format) {
 	int err;
-	struct __user_job_entry *user_job_entry;
+	struct qvio_user_job user_job;
+	struct qvio_user_job_pending* pending;
 
 	pr_info("enable=%d\n", (int)self->enable);
 
 	if(! self->enable)
 		return 0;
 
-	err = __user_job_entry_new(&user_job_entry);
-	if(err) {
-		pr_err("__user_job_entry_new() failed, err=%d\n", err);
+	memset(&user_job, 0, sizeof(struct qvio_user_job));
+	user_job.id = QVIO_USER_JOB_ID_S_FMT;
+	memcpy(&user_job.u.s_fmt.format, format, sizeof(struct v4l2_format));
+	pending = __pending_get(self, &user_job, false, NULL, NULL);
+	if(! pending) {
+		pr_err("__pending_get() failed\n");
+		err = -EBUSY;
 		goto err0;
 	}
 
-	user_job_entry->user_job.id = QVIO_USER_JOB_ID_S_FMT;
-	user_job_entry->user_job.sequence = (__u16)atomic_inc_return(&self->sequence);
-	memcpy(&user_job_entry->user_job.u.s_fmt.format, format, sizeof(struct v4l2_format));
-	__do_user_job(self, user_job_entry);
+	err = __do_user_job(self, pending, &user_job);
+	if(err) {
+		pr_err("__do_user_job() failed, err=%d\n", err);
+		goto err1;
+	}
 
-	err = __wait_for_user_job_done(self, NULL, NULL);
+	err = __wait_for_user_job_done(self, pending);
 	if(err) {
 		pr_err("__wait_for_user_job_done() failed, err=%d\n", err);
 		goto err0;
@@ -347,31 +1019,39 @@ int qvio_user_job_s_fmt(struct qvio_user_job_ctrl* self, struct v4l2_format *for
 
 	return 0;
 
+err1:
+	__pending_put(self, pending);
 err0:
 	return err;
 }
 
 int qvio_user_job_queue_setup(struct qvio_user_job_ctrl* self, unsigned int num_buffers) {
 	int err;
-	struct __user_job_entry *user_job_entry;
+	struct qvio_user_job user_job;
+	struct qvio_user_job_pending* pending;
 
 	pr_info("enable=%d\n", (int)self->enable);
 
 	if(! self->enable)
 		return 0;
 
-	err = __user_job_entry_new(&user_job_entry);
-	if(err) {
-		pr_err("__user_job_entry_new() failed, err=%d\n", err);
+	memset(&user_job, 0, sizeof(struct qvio_user_job));
+	user_job.id = QVIO_USER_JOB_ID_QUEUE_SETUP;
+	user_job.u.queue_setup.num_buffers = num_buffers;
+	pending = __pending_get(self, &user_job, false, NULL, NULL);
+	if(! pending) {
+		pr_err("__pending_get() failed\n");
+		err = -EBUSY;
 		goto err0;
 	}
 
-	user_job_entry->user_job.id = QVIO_USER_JOB_ID_QUEUE_SETUP;
-	user_job_entry->user_job.sequence = (__u16)atomic_inc_return(&self->sequence);
-	user_job_entry->user_job.u.queue_setup.num_buffers = num_buffers;
-	__do_user_job(self, user_job_entry);
+	err = __do_user_job(self, pending, &user_job);
+	if(err) {
+		pr_err("__do_user_job() failed, err=%d\n", err);
+		goto err1;
+	}
 
-	err = __wait_for_user_job_done(self, NULL, NULL);
+	err = __wait_for_user_job_done(self, pending);
 	if(err) {
 		pr_err("__wait_for_user_job_done() failed, err=%d\n", err);
 		goto err0;
@@ -379,31 +1059,39 @@ int qvio_user_job_queue_setup(struct qvio_user_job_ctrl* self, unsigned int num_
 
 	return 0;
 
+err1:
+	__pending_put(self, pending);
 err0:
 	return err;
 }
 
 int qvio_user_job_buf_init(struct qvio_user_job_ctrl* self, struct vb2_buffer *buffer, void* user, qvio_user_job_done_handler fn) {
 	int err;
-	struct __user_job_entry *user_job_entry;
+	struct qvio_user_job user_job;
+	struct qvio_user_job_pending* pending;
 
 	pr_info("enable=%d\n", (int)self->enable);
 
 	if(! self->enable)
 		return 0;
 
-	err = __user_job_entry_new(&user_job_entry);
-	if(err) {
-		pr_err("__user_job_entry_new() failed, err=%d\n", err);
+	memset(&user_job, 0, sizeof(struct qvio_user_job));
+	user_job.id = QVIO_USER_JOB_ID_BUF_INIT;
+	user_job.u.buf_init.index = buffer->index;
+	pending = __pending_get(self, &user_job, false, user, fn);
+	if(! pending) {
+		pr_err("__pending_get() failed\n");
+		err = -EBUSY;
 		goto err0;
 	}
 
-	user_job_entry->user_job.id = QVIO_USER_JOB_ID_BUF_INIT;
-	user_job_entry->user_job.sequence = (__u16)atomic_inc_return(&self->sequence);
-	user_job_entry->user_job.u.buf_init.index = buffer->index;
-	__do_user_job(self, user_job_entry);
+	err = __do_user_job(self, pending, &user_job);
+	if(err) {
+		pr_err("__do_user_job() failed, err=%d\n", err);
+		goto err1;
+	}
 
-	err = __wait_for_user_job_done(self, user, fn);
+	err = __wait_for_user_job_done(self, pending);
 	if(err) {
 		pr_err("__wait_for_user_job_done() failed, err=%d\n", err);
 		goto err0;
@@ -411,13 +1099,16 @@ int qvio_user_job_buf_init(struct qvio_user_job_ctrl* self, struct vb2_buffer *b
 
 	return 0;
 
+err1:
+	__pending_put(self, pending);
 err0:
 	return err;
 }
 
 int qvio_user_job_buf_cleanup(struct qvio_user_job_ctrl* self, struct vb2_buffer *buffer) {
 	int err;
-	struct __user_job_entry *user_job_entry;
+	struct qvio_user_job user_job;
+	struct qvio_user_job_pending* pending;
 
 #if 0 // DEBUG
 	pr_info("enable=%d\n", (int)self->enable);
@@ -426,18 +1117,23 @@ int qvio_user_job_buf_cleanup(struct qvio_user_job_ctrl* self, struct vb2_buffer
 	if(! self->enable)
 		return 0;
 
-	err = __user_job_entry_new(&user_job_entry);
-	if(err) {
-		pr_err("__user_job_entry_new() failed, err=%d\n", err);
+	memset(&user_job, 0, sizeof(struct qvio_user_job));
+	user_job.id = QVIO_USER_JOB_ID_BUF_CLEANUP;
+	user_job.u.buf_cleanup.index = buffer->index;
+	pending = __pending_get(self, &user_job, false, NULL, NULL);
+	if(! pending) {
+		pr_err("__pending_get() failed\n");
+		err = -EBUSY;
 		goto err0;
 	}
 
-	user_job_entry->user_job.id = QVIO_USER_JOB_ID_BUF_CLEANUP;
-	user_job_entry->user_job.sequence = (__u16)atomic_inc_return(&self->sequence);
-	user_job_entry->user_job.u.buf_cleanup.index = buffer->index;
-	__do_user_job(self, user_job_entry);
+	err = __do_user_job(self, pending, &user_job);
+	if(err) {
+		pr_err("__do_user_job() failed, err=%d\n", err);
+		goto err1;
+	}
 
-	err = __wait_for_user_job_done(self, NULL, NULL);
+	err = __wait_for_user_job_done(self, pending);
 	if(err) {
 		pr_err("__wait_for_user_job_done() failed, err=%d\n", err);
 		goto err0;
@@ -445,31 +1141,221 @@ int qvio_user_job_buf_cleanup(struct qvio_user_job_ctrl* self, struct vb2_buffer
 
 	return 0;
 
+err1:
+	__pending_put(self, pending);
+err0:
+	return err;
+}
+
+struct __buf_init_batch {
+	struct vb2_queue* queue;
+	struct qvio_user_job* user_job;
+	qvio_user_job_done_handler fn;
+};
+
+// split the batch answer into one BUF_INIT done per buffer
+static void __buf_init_batch_done(void* user, struct qvio_user_job_done* user_job_done) {
+	struct __buf_init_batch* batch = user;
+	struct qvio_user_job_done buf_init_done;
+	struct vb2_buffer* buffer;
+	unsigned int i;
+
+	for(i = 0;i < batch->user_job->u.buf_init_batch.count;i++) {
+		buffer = vb2_get_buffer(batch->queue, batch->user_job->u.buf_init_batch.bufs[i].index);
+		if(! buffer)
+			continue;
+
+		if(! user_job_done) {
+			batch->fn(buffer, NULL);
+			continue;
+		}
+
+		memset(&buf_init_done, 0, sizeof(struct qvio_user_job_done));
+		buf_init_done.id = QVIO_USER_JOB_ID_BUF_INIT;
+		buf_init_done.sequence = user_job_done->sequence;
+		buf_init_done.u.buf_init.flags = user_job_done->u.buf_init_batch.flags;
+		buf_init_done.u.buf_init.dma_buf = user_job_done->u.buf_init_batch.dma_buf[i];
+		memcpy(buf_init_done.u.buf_init.offset, user_job_done->u.buf_init_batch.offset, sizeof(buf_init_done.u.buf_init.offset));
+		memcpy(buf_init_done.u.buf_init.pitch, user_job_done->u.buf_init_batch.pitch, sizeof(buf_init_done.u.buf_init.pitch));
+		memcpy(buf_init_done.u.buf_init.psize, user_job_done->u.buf_init_batch.psize, sizeof(buf_init_done.u.buf_init.psize));
+		batch->fn(buffer, &buf_init_done);
+	}
+}
+
+int qvio_user_job_buf_init_batch(struct qvio_user_job_ctrl* self, struct vb2_queue *queue,
+	unsigned int first, unsigned int count, qvio_user_job_done_handler fn) {
+	int err;
+	struct qvio_user_job* user_job;
+	struct qvio_user_job_pending* pending;
+	struct vb2_buffer* buffer;
+	struct __buf_init_batch batch;
+	unsigned int i, n, p;
+
+	pr_info("enable=%d first=%u count=%u\n", (int)self->enable, first, count);
+
+	if(! self->enable)
+		return 0;
+
+	// too big for the stack
+	user_job = kzalloc(sizeof(struct qvio_user_job), GFP_KERNEL);
+	if(! user_job) {
+		pr_err("out of memory\n");
+		err = -ENOMEM;
+		goto err0;
+	}
+
+	for(i = first;i < first + count;) {
+		memset(user_job, 0, sizeof(struct qvio_user_job));
+		user_job->id = QVIO_USER_JOB_ID_BUF_INIT_BATCH;
+
+		for(n = 0;n < QVIO_USER_JOB_MAX_BATCH && i < first + count;i++) {
+			buffer = vb2_get_buffer(queue, i);
+			if(! buffer)
+				continue;
+
+			user_job->u.buf_init_batch.num_planes = min_t(unsigned int, buffer->num_planes, QVIO_USER_JOB_MAX_PLANES);
+			user_job->u.buf_init_batch.bufs[n].index = buffer->index;
+			for(p = 0;p < user_job->u.buf_init_batch.num_planes;p++) {
+				user_job->u.buf_init_batch.bufs[n].offset[p] = buffer->planes[p].m.offset;
+				user_job->u.buf_init_batch.bufs[n].length[p] = buffer->planes[p].length;
+			}
+			n++;
+		}
+		user_job->u.buf_init_batch.count = n;
+
+		if(n == 0)
+			break;
+
+		batch.queue = queue;
+		batch.user_job = user_job;
+		batch.fn = fn;
+		pending = __pending_get(self, user_job, false, fn ? &batch : NULL, fn ? __buf_init_batch_done : NULL);
+		if(! pending) {
+			pr_err("__pending_get() failed\n");
+			err = -EBUSY;
+			goto err1;
+		}
+
+		err = __do_user_job(self, pending, user_job);
+		if(err) {
+			pr_err("__do_user_job() failed, err=%d\n", err);
+			goto err2;
+		}
+
+		err = __wait_for_user_job_done(self, pending);
+		if(err) {
+			pr_err("__wait_for_user_job_done() failed, err=%d\n", err);
+			goto err1;
+		}
+	}
+
+	kfree(user_job);
+
+	return 0;
+
+err2:
+	__pending_put(self, pending);
+err1:
+	kfree(user_job);
+err0:
+	return err;
+}
+
+int qvio_user_job_buf_cleanup_batch(struct qvio_user_job_ctrl* self, struct vb2_queue *queue,
+	unsigned int first, unsigned int count) {
+	int err;
+	struct qvio_user_job* user_job;
+	struct qvio_user_job_pending* pending;
+	struct vb2_buffer* buffer;
+	unsigned int i, n;
+
+	pr_info("enable=%d first=%u count=%u\n", (int)self->enable, first, count);
+
+	if(! self->enable)
+		return 0;
+
+	user_job = kzalloc(sizeof(struct qvio_user_job), GFP_KERNEL);
+	if(! user_job) {
+		pr_err("out of memory\n");
+		err = -ENOMEM;
+		goto err0;
+	}
+
+	for(i = first;i < first + count;) {
+		memset(user_job, 0, sizeof(struct qvio_user_job));
+		user_job->id = QVIO_USER_JOB_ID_BUF_CLEANUP_BATCH;
+
+		for(n = 0;n < QVIO_USER_JOB_MAX_BATCH && i < first + count;i++) {
+			buffer = vb2_get_buffer(queue, i);
+			if(! buffer)
+				continue;
+
+			user_job->u.buf_cleanup_batch.index[n++] = buffer->index;
+		}
+		user_job->u.buf_cleanup_batch.count = n;
+
+		if(n == 0)
+			break;
+
+		pending = __pending_get(self, user_job, false, NULL, NULL);
+		if(! pending) {
+			pr_err("__pending_get() failed\n");
+			err = -EBUSY;
+			goto err1;
+		}
+
+		err = __do_user_job(self, pending, user_job);
+		if(err) {
+			pr_err("__do_user_job() failed, err=%d\n", err);
+			goto err2;
+		}
+
+		err = __wait_for_user_job_done(self, pending);
+		if(err) {
+			pr_err("__wait_for_user_job_done() failed, err=%d\n", err);
+			goto err1;
+		}
+	}
+
+	kfree(user_job);
+
+	return 0;
+
+err2:
+	__pending_put(self, pending);
+err1:
+	kfree(user_job);
 err0:
 	return err;
 }
 
 int qvio_user_job_start_streaming(struct qvio_user_job_ctrl* self) {
 	int err;
-	struct __user_job_entry *user_job_entry;
+	struct qvio_user_job user_job;
+	struct qvio_user_job_pending* pending;
 
 	pr_info("enable=%d\n", (int)self->enable);
 
 	if(! self->enable)
 		return 0;
 
-	err = __user_job_entry_new(&user_job_entry);
-	if(err) {
-		pr_err("__user_job_entry_new() failed, err=%d\n", err);
+	memset(&user_job, 0, sizeof(struct qvio_user_job));
+	user_job.id = QVIO_USER_JOB_ID_START_STREAMING;
+	user_job.u.start_streaming.flags = 0;
+	pending = __pending_get(self, &user_job, false, NULL, NULL);
+	if(! pending) {
+		pr_err("__pending_get() failed\n");
+		err = -EBUSY;
 		goto err0;
 	}
 
-	user_job_entry->user_job.id = QVIO_USER_JOB_ID_START_STREAMING;
-	user_job_entry->user_job.sequence = (__u16)atomic_inc_return(&self->sequence);
-	user_job_entry->user_job.u.start_streaming.flags = 0;
-	__do_user_job(self, user_job_entry);
+	err = __do_user_job(self, pending, &user_job);
+	if(err) {
+		pr_err("__do_user_job() failed, err=%d\n", err);
+		goto err1;
+	}
 
-	err = __wait_for_user_job_done(self, NULL, NULL);
+	err = __wait_for_user_job_done(self, pending);
 	if(err) {
 		pr_err("__wait_for_user_job_done() failed, err=%d\n", err);
 		goto err0;
@@ -477,31 +1363,39 @@ int qvio_user_job_start_streaming(struct qvio_user_job_ctrl* self) {
 
 	return 0;
 
+err1:
+	__pending_put(self, pending);
 err0:
 	return err;
 }
 
 int qvio_user_job_stop_streaming(struct qvio_user_job_ctrl* self) {
 	int err;
-	struct __user_job_entry *user_job_entry;
+	struct qvio_user_job user_job;
+	struct qvio_user_job_pending* pending;
 
 	pr_info("enable=%d\n", (int)self->enable);
 
 	if(! self->enable)
 		return 0;
 
-	err = __user_job_entry_new(&user_job_entry);
-	if(err) {
-		pr_err("__user_job_entry_new() failed, err=%d\n", err);
+	memset(&user_job, 0, sizeof(struct qvio_user_job));
+	user_job.id = QVIO_USER_JOB_ID_STOP_STREAMING;
+	user_job.u.stop_streaming.flags = 0;
+	pending = __pending_get(self, &user_job, false, NULL, NULL);
+	if(! pending) {
+		pr_err("__pending_get() failed\n");
+		err = -EBUSY;
 		goto err0;
 	}
 
-	user_job_entry->user_job.id = QVIO_USER_JOB_ID_STOP_STREAMING;
-	user_job_entry->user_job.sequence = (__u16)atomic_inc_return(&self->sequence);
-	user_job_entry->user_job.u.stop_streaming.flags = 0;
-	__do_user_job(self, user_job_entry);
+	err = __do_user_job(self, pending, &user_job);
+	if(err) {
+		pr_err("__do_user_job() failed, err=%d\n", err);
+		goto err1;
+	}
 
-	err = __wait_for_user_job_done(self, NULL, NULL);
+	err = __wait_for_user_job_done(self, pending);
 	if(err) {
 		pr_err("__wait_for_user_job_done() failed, err=%d\n", err);
 		goto err0;
@@ -509,13 +1403,16 @@ int qvio_user_job_stop_streaming(struct qvio_user_job_ctrl* self) {
 
 	return 0;
 
+err1:
+	__pending_put(self, pending);
 err0:
 	return err;
 }
 
-int qvio_user_job_buf_done(struct qvio_user_job_ctrl* self, struct vb2_buffer *buffer) {
+int qvio_user_job_buf_done(struct qvio_user_job_ctrl* self, struct vb2_buffer *buffer, void* user, qvio_user_job_done_handler fn) {
 	int err;
-	struct __user_job_entry *user_job_entry;
+	struct qvio_user_job user_job;
+	struct qvio_user_job_pending* pending;
 
 #if 0 // DEBUG
 	pr_info("enable=%d\n", (int)self->enable);
@@ -524,25 +1421,115 @@ int qvio_user_job_buf_done(struct qvio_user_job_ctrl* self, struct vb2_buffer *b
 	if(! self->enable)
 		return 0;
 
-	err = __user_job_entry_new(&user_job_entry);
-	if(err) {
-		pr_err("__user_job_entry_new() failed, err=%d\n", err);
+	memset(&user_job, 0, sizeof(struct qvio_user_job));
+	user_job.id = QVIO_USER_JOB_ID_BUF_DONE;
+	user_job.u.buf_done.index = buffer->index;
+
+	// what the daemon answered since the last post completes first and frees its slot
+	qvio_user_job_reap(self);
+
+	// output, what the application queued
+	if(V4L2_TYPE_IS_OUTPUT(buffer->type)) {
+		unsigned int p;
+
+		for(p = 0;p < buffer->num_planes && p < QVIO_USER_JOB_MAX_PLANES;p++)
+			user_job.u.buf_done.bytesused[p] = vb2_get_plane_payload(buffer, p);
+		user_job.u.buf_done.timestamp_sec = (__u32)div_u64_rem(buffer->timestamp, NSEC_PER_SEC, &user_job.u.buf_done.timestamp_nsec);
+	}
+	pending = __pending_get(self, &user_job, true, user, fn);
+	if(! pending) {
+		pr_err_ratelimited("__pending_get() failed\n");
+		err = -EBUSY;
 		goto err0;
 	}
 
-	user_job_entry->user_job.id = QVIO_USER_JOB_ID_BUF_DONE;
-	user_job_entry->user_job.sequence = (__u16)atomic_inc_return(&self->sequence);
-	user_job_entry->user_job.u.buf_done.index = buffer->index;
-	__do_user_job(self, user_job_entry);
-
-	err = __wait_for_user_job_done(self, NULL, NULL);
+	// no wait, fn is called once the daemon returns the matching done
+	err = __do_user_job(self, pending, &user_job);
 	if(err) {
-		pr_err("__wait_for_user_job_done() failed, err=%d\n", err);
-		goto err0;
+		pr_err_ratelimited("__do_user_job() failed, err=%d\n", err);
+		goto err1;
 	}
 
 	return 0;
 
+err1:
+	__pending_put(self, pending);
 err0:
 	return err;
 }
+
+void qvio_user_job_cancel(struct qvio_user_job_ctrl* self) {
+	struct qvio_user_job_pending* pending;
+	void* user;
+	qvio_user_job_done_handler fn;
+	unsigned long flags;
+	int i;
+
+	pr_info("pending_num=%d\n", self->pending_num);
+
+	// outstanding async jobs complete with no done, late dones are dropped as unexpected
+	for(i = 0;i < QVIO_USER_JOB_MAX_PENDING;i++) {
+		pending = &self->pending[i];
+
+		spin_lock_irqsave(&self->done_lock, flags);
+		if(! pending->used || ! pending->async) {
+			spin_unlock_irqrestore(&self->done_lock, flags);
+			continue;
+		}
+
+		__stats_cancelled(self, pending->id);
+
+		user = pending->user;
+		fn = pending->fn;
+		__pending_put_locked(self, pending);
+		spin_unlock_irqrestore(&self->done_lock, flags);
+
+		if(fn)
+			fn(user, NULL);
+	}
+}
+
+void qvio_user_job_abandon(struct qvio_user_job_ctrl* self, void* user) {
+	struct qvio_user_job_pending* pending;
+	struct qvio_user_job_consumer* consumer = NULL;
+	struct __user_job_entry *user_job_entry, *tmp;
+	struct __user_job_entry* abandoned = NULL;
+	struct list_head* job_list;
+	unsigned long flags;
+	__u16 sequence = 0;
+	bool found = false;
+	int i;
+
+	// the slot is free for the next post, a late done finds no sequence and is dropped
+	spin_lock_irqsave(&self->job_list_lock, flags);
+	spin_lock(&self->done_lock);
+	for(i = 0;i < QVIO_USER_JOB_MAX_PENDING;i++) {
+		pending = &self->pending[i];
+
+		if(pending->used && pending->async && pending->user == user) {
+			__stats_cancelled(self, pending->id);
+
+			consumer = pending->consumer;
+			sequence = pending->sequence;
+			__pending_put_locked(self, pending);
+			found = true;
+			break;
+		}
+	}
+	spin_unlock(&self->done_lock);
+
+	// not taken by a worker yet, none will see it, a job in the ring is past recall
+	if(found) {
+		job_list = consumer ? &consumer->job_list : &self->job_list;
+		list_for_each_entry_safe(user_job_entry, tmp, job_list, node) {
+			if(user_job_entry->user_job.sequence == sequence) {
+				list_del(&user_job_entry->node);
+				abandoned = user_job_entry;
+				break;
+			}
+		}
+	}
+	spin_unlock_irqrestore(&self->job_list_lock, flags);
+
+	kfree(abandoned);
+}
@@ -7,24 +7,79 @@
 #include <linux/fs.h>
 #include <linux/list.h>
 #include <linux/spinlock_types.h>
+#include <linux/ktime.h>
 
 #include "uapi/qvio.h"
 
+// user_job_done is NULL if the job was cancelled,
+// called from the context of the worker that answered, e.g. for its dma-buf fds
 typedef void (*qvio_user_job_done_handler)(void* user, struct qvio_user_job_done* user_job_done);
 
+#define QVIO_USER_JOB_MAX_PENDING 64
+
+// how buffer jobs are spread over the consumers, session jobs always go to the first one
+enum {
+	QVIO_USER_JOB_DISPATCH_RR,		// round-robin
+	QVIO_USER_JOB_DISPATCH_INDEX,	// by vb2 buffer index, a buffer stays with one consumer
+};
+
+struct qvio_user_job_ctrl;
+
+// one user-job fd, a daemon worker thread or process
+struct qvio_user_job_consumer {
+	struct list_head node;
+	struct qvio_user_job_ctrl* ctrl;
+	int pending_num;
+	int wait_num; // of pending_num, the ones the driver blocks on, F_WAIT is raised for them
+
+	wait_queue_head_t job_wq;
+	struct list_head job_list;
+
+	// mmap'ed job/done rings, used instead of the list once the worker maps them
+	struct qvio_user_job_rings* rings;
+	bool ring_mode;
+};
+
+struct qvio_user_job_pending {
+	bool used;
+	bool completed;
+	bool cancelled;
+	bool running;
+	bool async;
+	bool waiting;
+	__u16 id;
+	__u16 sequence;
+	void* user;
+	qvio_user_job_done_handler fn;
+	struct qvio_user_job_consumer* consumer; // the only one allowed to complete it
+
+	// latency, t_get stays 0 for jobs taken from the ring
+	ktime_t t_post;
+	ktime_t t_get;
+	ktime_t t_done;
+};
+
 struct qvio_user_job_ctrl {
 	bool enable;
 	atomic_t sequence;
 
-	// user-job list
-	wait_queue_head_t job_wq;
+	// user-job consumers, job_list holds the jobs posted while none is attached
 	spinlock_t job_list_lock;
 	struct list_head job_list;
+	struct list_head consumers;
+	int consumer_num;
+	unsigned int consumer_next;
+	int dispatch;
 
-	// user-job-done lsit
+	// user-job-done, matched to the posted job by sequence
 	wait_queue_head_t done_wq;
-	spinlock_t done_list_lock;
-	struct list_head done_list;
+	spinlock_t done_lock;
+	struct qvio_user_job_pending pending[QVIO_USER_JOB_MAX_PENDING];
+	int pending_num;
+
+	// user-job latency, read with QVID_IOC_USER_JOB_STATS
+	spinlock_t stats_lock;
+	struct qvio_user_job_stats_id stats[QVIO_USER_JOB_STATS_IDS];
 
 	// user-job control
 	const struct file_operations* ctrl_fops;
@@ -33,13 +88,31 @@ struct qvio_user_job_ctrl {
 void qvio_user_job_start(struct qvio_user_job_ctrl* self);
 void qvio_user_job_stop(struct qvio_user_job_ctrl* self);
 
+// user-job fd, one per worker
+struct qvio_user_job_consumer* qvio_user_job_consumer_new(struct qvio_user_job_ctrl* self);
+void qvio_user_job_consumer_free(struct qvio_user_job_consumer* consumer);
+
 // user-job
 int qvio_user_job_s_fmt(struct qvio_user_job_ctrl* self, struct v4l2_format *format);
 int qvio_user_job_queue_setup(struct qvio_user_job_ctrl* self, unsigned int num_buffers);
 int qvio_user_job_buf_init(struct qvio_user_job_ctrl* self, struct vb2_buffer *buffer, void* user, qvio_user_job_done_handler fn);
 int qvio_user_job_buf_cleanup(struct qvio_user_job_ctrl* self, struct vb2_buffer *buffer);
+
+// one job per QVIO_USER_JOB_MAX_BATCH buffers of [first, first + count),
+// fn is called per buffer with the vb2_buffer as user and a BUF_INIT shaped done
+int qvio_user_job_buf_init_batch(struct qvio_user_job_ctrl* self, struct vb2_queue *queue,
+	unsigned int first, unsigned int count, qvio_user_job_done_handler fn);
+int qvio_user_job_buf_cleanup_batch(struct qvio_user_job_ctrl* self, struct vb2_queue *queue,
+	unsigned int first, unsigned int count);
 int qvio_user_job_start_streaming(struct qvio_user_job_ctrl* self);
 int qvio_user_job_stop_streaming(struct qvio_user_job_ctrl* self);
-int qvio_user_job_buf_done(struct qvio_user_job_ctrl* self, struct vb2_buffer *buffer);
+
+// asynchronous, fn is called from the context the matching done arrives in
+int qvio_user_job_buf_done(struct qvio_user_job_ctrl* self, struct vb2_buffer *buffer, void* user, qvio_user_job_done_handler fn);
+void qvio_user_job_cancel(struct qvio_user_job_ctrl* self);
+// complete the BUF_DONE jobs already answered on the done rings, without waiting for a kick
+void qvio_user_job_reap(struct qvio_user_job_ctrl* self);
+// the caller completes the buffer of user itself, the slot is released and a late done is dropped
+void qvio_user_job_abandon(struct qvio_user_job_ctrl* self, void* user);
 
 #endif // __QVIO_USER_JOB_H__
\ No newline at end of file
@@ -12,6 +12,10 @@
 #include <media/v4l2-event.h>
 #include <media/v4l2-ctrls.h>
 #include <linux/anon_inodes.h>
+#include <linux/gcd.h>
+
+// frame intervals offered on top of the card's fixed source rate, as source frames per output frame
+static const int __frame_decimations[] = {1, 2, 3, 4, 5, 6, 10, 12, 15, 20, 30, 60};
 
 static int __ioctl_querycap(struct file *file, void *fh, struct v4l2_capability *capability);
 static int __ioctl_enum_fmt(struct file *file, void *fh, struct v4l2_fmtdesc *format);
@@ -28,17 +32,25 @@ static int __ioctl_g_parm(struct file *file, void *fh, struct v4l2_streamparm *p
 static int __ioctl_s_parm(struct file *file, void *fh, struct v4l2_streamparm *param);
 static int __ioctl_enum_framesizes(struct file *file, void *fh, struct v4l2_frmsizeenum *frame_sizes);
 static int __ioctl_enum_frameintervals(struct file *file, void *fh, struct v4l2_frmivalenum *frame_intervals);
+static int __ioctl_subscribe_event(struct v4l2_fh *fh, const struct v4l2_event_subscription *sub);
+static int __ioctl_query_dv_timings(struct file *file, void *fh, struct v4l2_dv_timings *timings);
+static int __ioctl_g_dv_timings(struct file *file, void *fh, struct v4l2_dv_timings *timings);
+static int __ioctl_reqbufs(struct file *file, void *fh, struct v4l2_requestbuffers *p);
+static int __ioctl_create_bufs(struct file *file, void *fh, struct v4l2_create_buffers *p);
+static int __video_open(struct file *file);
+static int __video_release(struct file *file);
+static int __video_mmap(struct file *file, struct vm_area_struct *vma);
 static long __ioctl_default(struct file *file, void *fh, bool valid_prio, unsigned int cmd, void *arg);
 static int __anon_fd(const char* name, const struct file_operations *fops, void *priv, int flags);
 
 static const struct v4l2_file_operations __video_fops = {
 	.owner          = THIS_MODULE    ,
-	.open           = v4l2_fh_open   ,
-	.release        = vb2_fop_release,
+	.open           = __video_open   ,
+	.release        = __video_release,
 	.unlocked_ioctl = video_ioctl2   ,
 	.read           = vb2_fop_read   ,
 	.write          = vb2_fop_write  ,
-	.mmap           = vb2_fop_mmap   ,
+	.mmap           = __video_mmap   ,
 	.poll           = vb2_fop_poll   ,
 };
 
@@ -58,12 +70,12 @@ static const struct v4l2_ioctl_ops __v4l2_ioctl_ops = {
 	.vidioc_try_fmt_vid_out        = __ioctl_try_fmt,
 	.vidioc_try_fmt_vid_cap_mplane = __ioctl_try_fmt,
 	.vidioc_try_fmt_vid_out_mplane = __ioctl_try_fmt,
-	.vidioc_reqbufs                = vb2_ioctl_reqbufs,
+	.vidioc_reqbufs                = __ioctl_reqbufs,
 	.vidioc_querybuf               = vb2_ioctl_querybuf,
 	.vidioc_qbuf                   = vb2_ioctl_qbuf,
 	.vidioc_expbuf                 = vb2_ioctl_expbuf,
 	.vidioc_dqbuf                  = vb2_ioctl_dqbuf,
-	.vidioc_create_bufs            = vb2_ioctl_create_bufs,
+	.vidioc_create_bufs            = __ioctl_create_bufs,
 	.vidioc_prepare_buf            = vb2_ioctl_prepare_buf,
 	.vidioc_streamon               = vb2_ioctl_streamon,
 	.vidioc_streamoff              = vb2_ioctl_streamoff,
@@ -78,8 +90,10 @@ static const struct v4l2_ioctl_ops __v4l2_ioctl_ops = {
 	.vidioc_log_status             = v4l2_ctrl_log_status,
 	.vidioc_enum_framesizes        = __ioctl_enum_framesizes,
 	.vidioc_enum_frameintervals    = __ioctl_enum_frameintervals,
-	.vidioc_subscribe_event        = v4l2_ctrl_subscribe_event,
+	.vidioc_subscribe_event        = __ioctl_subscribe_event,
 	.vidioc_unsubscribe_event      = v4l2_event_unsubscribe,
+	.vidioc_query_dv_timings       = __ioctl_query_dv_timings,
+	.vidioc_g_dv_timings           = __ioctl_g_dv_timings,
 	.vidioc_default                = __ioctl_default,
 };
 
@@ -95,6 +109,7 @@ struct qvio_video* qvio_video_new(void) {
 	self->halign = 0x40;
 	self->valign = 1;
 	qvio_user_job_start(&self->user_job_ctrl);
+	qvio_source_init(&self->source);
 
 	return self;
 }
@@ -210,8 +225,9 @@ int qvio_video_start(struct qvio_video* self) {
 	self->current_parm.type = self->buffer_type;
 	self->current_parm.parm.capture.capability = V4L2_CAP_TIMEPERFRAME;
 	self->current_parm.parm.capture.capturemode = 0;
-	self->current_parm.parm.capture.timeperframe.numerator = 60;
-	self->current_parm.parm.capture.timeperframe.denominator = 1;
+	self->current_parm.parm.capture.timeperframe.numerator = 1;
+	self->current_parm.parm.capture.timeperframe.denominator = QVIO_FRAME_RATE;
+	self->queue.decimate = 1;
 
 	snprintf(self->vdev->name, sizeof(self->vdev->name), "%s", self->v4l2_dev.name);
 	self->vdev->v4l2_dev = &self->v4l2_dev;
@@ -230,8 +246,17 @@ int qvio_video_start(struct qvio_video* self) {
 		goto err3;
 	}
 
+	err = qvio_source_start(&self->source);
+	if(err) {
+		pr_err("qvio_source_start() failed, err=%d\n", err);
+		goto err4;
+	}
+
 	return 0;
 
+err4:
+	video_unregister_device(self->vdev);
+
 err3:
 	video_device_release(self->vdev);
 err2:
@@ -245,14 +270,40 @@ err0:
 void qvio_video_stop(struct qvio_video* self) {
 	pr_info("\n");
 
+	qvio_group_leave(&self->qdev->group, self->channel);
+	qvio_source_stop(&self->source);
+
 	video_unregister_device(self->vdev);
 	video_device_release(self->vdev);
 	qvio_queue_stop(&self->queue);
 	v4l2_device_unregister(&self->v4l2_dev);
 }
 
+// UYVY/NV16/P010/v210 are format table and plane size plumbing only: no card has a confirmed
+// 0xD0 input format code for them, so only nodes without an engine (platform, user-job) offer them
+static bool __fmt_supported(struct qvio_video* self, __u32 pixelformat) {
+	switch(pixelformat) {
+	case V4L2_PIX_FMT_UYVY:
+	case V4L2_PIX_FMT_NV16:
+	case V4L2_PIX_FMT_P010:
+	case QVIO_PIX_FMT_V210:
+		break;
+
+	default:
+		return true;
+	}
+
+#if 1 // USE_LIBXDMA
+	if(self->qdev->xdev)
+		return false;
+#endif // USE_LIBXDMA
+
+	return true;
+}
+
 int qvio_video_try_fmt(struct qvio_video* self, struct v4l2_format *format) {
 	int err;
+	__u32 pixelformat;
 
 	pr_info("\n");
 
@@ -270,6 +321,10 @@ int qvio_video_try_fmt(struct qvio_video* self, struct v4l2_format *format) {
 		case V4L2_PIX_FMT_YUYV:
 		case V4L2_PIX_FMT_NV12:
 		case V4L2_PIX_FMT_M420:
+		case V4L2_PIX_FMT_UYVY:
+		case V4L2_PIX_FMT_NV16:
+		case V4L2_PIX_FMT_P010:
+		case QVIO_PIX_FMT_V210:
 			break;
 
 		default:
@@ -279,6 +334,7 @@ int qvio_video_try_fmt(struct qvio_video* self, struct v4l2_format *format) {
 			goto err0;
 			break;
 		}
+		pixelformat = format->fmt.pix.pixelformat;
 		break;
 
 	case V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE:
@@ -287,6 +343,10 @@ int qvio_video_try_fmt(struct qvio_video* self, struct v4l2_format *format) {
 		case V4L2_PIX_FMT_YUYV:
 		case V4L2_PIX_FMT_NV12:
 		case V4L2_PIX_FMT_M420:
+		case V4L2_PIX_FMT_UYVY:
+		case V4L2_PIX_FMT_NV16:
+		case V4L2_PIX_FMT_P010:
+		case QVIO_PIX_FMT_V210:
 			break;
 
 		default:
@@ -296,6 +356,7 @@ int qvio_video_try_fmt(struct qvio_video* self, struct v4l2_format *format) {
 			goto err0;
 			break;
 		}
+		pixelformat = format->fmt.pix_mp.pixelformat;
 		break;
 
 	default:
@@ -306,6 +367,13 @@ int qvio_video_try_fmt(struct qvio_video* self, struct v4l2_format *format) {
 		break;
 	}
 
+	if(! __fmt_supported(self, pixelformat)) {
+		pr_err("unsupported value, pixelformat=0x%X device_id=0x%08X\n", pixelformat, self->qdev->device_id);
+		err = -EINVAL;
+
+		goto err0;
+	}
+
 	err = 0;
 
 	return err;
@@ -314,6 +382,183 @@ err0:
 	return err;
 }
 
+long qvio_video_s_group(struct qvio_video* self, int enable) {
+	long ret;
+	int err;
+
+	pr_info("channel=%d enable=%d\n", self->channel, enable);
+
+	if(vb2_is_streaming(qvio_queue_get_vb2_queue(&self->queue))) {
+		pr_err("unexpected, streaming\n");
+		ret = -EBUSY;
+
+		goto err0;
+	}
+
+	if(! enable) {
+		qvio_group_leave(&self->qdev->group, self->channel);
+
+		return 0;
+	}
+
+	err = qvio_group_join(&self->qdev->group, self->channel);
+	if(err) {
+		pr_err("qvio_group_join() failed, err=%d", err);
+		ret = err;
+
+		goto err0;
+	}
+
+	ret = 0;
+
+	return ret;
+
+err0:
+	return ret;
+}
+
+long qvio_video_g_deadline(struct qvio_video* self, struct qvio_deadline* deadline) {
+	memset(deadline, 0, sizeof(*deadline));
+	deadline->fallback = self->queue.deadline_fallback;
+	deadline->interval_us = (__u32)ktime_to_us(self->queue.deadline_interval);
+	deadline->misses = self->queue.deadline_misses;
+
+	return 0;
+}
+
+long qvio_video_s_deadline(struct qvio_video* self, struct qvio_deadline* deadline) {
+	long ret;
+
+	pr_info("channel=%d fallback=%u\n", self->channel, deadline->fallback);
+
+	if(! self->user_job_ctrl.enable) {
+		pr_err("unexpected, no user-job\n");
+		ret = -ENOTTY;
+
+		goto err0;
+	}
+
+	if(deadline->fallback > QVIO_DEADLINE_SLATE) {
+		pr_err("unexpected value, deadline->fallback=%u\n", deadline->fallback);
+		ret = -EINVAL;
+
+		goto err0;
+	}
+
+	if(vb2_is_streaming(qvio_queue_get_vb2_queue(&self->queue))) {
+		pr_err("unexpected, streaming\n");
+		ret = -EBUSY;
+
+		goto err0;
+	}
+
+	self->queue.deadline_fallback = deadline->fallback;
+
+	ret = 0;
+
+	return ret;
+
+err0:
+	return ret;
+}
+
+long qvio_video_g_frame_clock(struct qvio_video* self, struct qvio_frame_clock* frame_clock) {
+	struct qvio_queue* queue = &self->queue;
+
+	memset(frame_clock, 0, sizeof(*frame_clock));
+	frame_clock->enable = queue->frame_clock;
+	frame_clock->interval_ns = (__u32)queue->clock_step;
+	frame_clock->ticks = queue->clock_ticks;
+	frame_clock->frames = queue->clock_frames;
+	frame_clock->underruns = queue->clock_underruns;
+	frame_clock->overruns = queue->clock_overruns;
+	if(queue->clock_frames)
+		frame_clock->jitter_avg_ns = (__u32)div_u64(queue->clock_jitter_sum, queue->clock_frames);
+	frame_clock->jitter_max_ns = queue->clock_jitter_max;
+	frame_clock->drift_ns = queue->clock_drift;
+
+	return 0;
+}
+
+long qvio_video_s_frame_clock(struct qvio_video* self, struct qvio_frame_clock* frame_clock) {
+	long ret;
+
+	pr_info("channel=%d enable=%u\n", self->channel, frame_clock->enable);
+
+	if(! self->user_job_ctrl.enable || self->vfl_dir != VFL_DIR_RX) {
+		pr_err("unexpected, no user-job capture\n");
+		ret = -ENOTTY;
+
+		goto err0;
+	}
+
+	if(vb2_is_streaming(qvio_queue_get_vb2_queue(&self->queue))) {
+		pr_err("unexpected, streaming\n");
+		ret = -EBUSY;
+
+		goto err0;
+	}
+
+	self->queue.frame_clock = frame_clock->enable ? 1 : 0;
+
+	ret = 0;
+
+	return ret;
+
+err0:
+	return ret;
+}
+
+long qvio_video_g_watchdog(struct qvio_video* self, struct qvio_watchdog* watchdog) {
+	struct qvio_queue* queue = &self->queue;
+
+	memset(watchdog, 0, sizeof(*watchdog));
+	watchdog->frames = queue->watchdog_frames;
+	if(queue->watchdog_enable)
+		watchdog->timeout_us = jiffies_to_usecs(queue->watchdog_timeout);
+	watchdog->recoveries = queue->watchdog_recoveries;
+	watchdog->failures = queue->watchdog_failures;
+	watchdog->last_ns = queue->watchdog_last;
+
+	return 0;
+}
+
+long qvio_video_s_watchdog(struct qvio_video* self, struct qvio_watchdog* watchdog) {
+	long ret;
+
+	pr_info("channel=%d frames=%u\n", self->channel, watchdog->frames);
+
+	if(self->user_job_ctrl.enable || self->vfl_dir != VFL_DIR_RX) {
+		pr_err("unexpected, no engine capture\n");
+		ret = -ENOTTY;
+
+		goto err0;
+	}
+
+	if(watchdog->frames > INT_MAX) {
+		pr_err("unexpected value, watchdog->frames=%u\n", watchdog->frames);
+		ret = -EINVAL;
+
+		goto err0;
+	}
+
+	if(vb2_is_streaming(qvio_queue_get_vb2_queue(&self->queue))) {
+		pr_err("unexpected, streaming\n");
+		ret = -EBUSY;
+
+		goto err0;
+	}
+
+	self->queue.watchdog_frames = watchdog->frames;
+
+	ret = 0;
+
+	return ret;
+
+err0:
+	return ret;
+}
+
 long qvio_video_buf_done(struct qvio_video* self) {
 	long ret;
 	int err;
@@ -386,6 +631,30 @@ static int __ioctl_enum_fmt(struct file *file, void *fh, struct v4l2_fmtdesc *fo
 		format->pixelformat = V4L2_PIX_FMT_M420;
 		break;
 
+	case 3:
+		format->flags = 0;
+		snprintf((char *) format->description, sizeof(format->description), "UYVY");
+		format->pixelformat = V4L2_PIX_FMT_UYVY;
+		break;
+
+	case 4:
+		format->flags = 0;
+		snprintf((char *) format->description, sizeof(format->description), "NV16");
+		format->pixelformat = V4L2_PIX_FMT_NV16;
+		break;
+
+	case 5:
+		format->flags = 0;
+		snprintf((char *) format->description, sizeof(format->description), "P010");
+		format->pixelformat = V4L2_PIX_FMT_P010;
+		break;
+
+	case 6:
+		format->flags = 0;
+		snprintf((char *) format->description, sizeof(format->description), "v210");
+		format->pixelformat = QVIO_PIX_FMT_V210;
+		break;
+
 	default:
 		pr_err("unexpected value, format->index=%d\n", (int)format->index);
 		err = -EINVAL;
@@ -394,6 +663,13 @@ static int __ioctl_enum_fmt(struct file *file, void *fh, struct v4l2_fmtdesc *fo
 		break;
 	}
 
+	// the formats without a confirmed 0xD0 code come last, the list ends before them
+	if(! __fmt_supported(self, format->pixelformat)) {
+		err = -EINVAL;
+
+		goto err0;
+	}
+
 	return 0;
 
 err0:
@@ -428,6 +704,7 @@ static int __ioctl_s_fmt(struct file *file, void *fh, struct v4l2_format *format
 	case V4L2_BUF_TYPE_VIDEO_OUTPUT:
 		switch(format->fmt.pix.pixelformat) {
 		case V4L2_PIX_FMT_YUYV:
+		case V4L2_PIX_FMT_UYVY:
 			format->fmt.pix.bytesperline = ALIGN(format->fmt.pix.width * 2, self->halign);
 			format->fmt.pix.sizeimage = format->fmt.pix.bytesperline * ALIGN(format->fmt.pix.height, self->valign);
 			break;
@@ -442,6 +719,21 @@ static int __ioctl_s_fmt(struct file *file, void *fh, struct v4l2_format *format
 			format->fmt.pix.sizeimage = format->fmt.pix.bytesperline * ALIGN(format->fmt.pix.height * 3 / 2, self->valign);
 			break;
 
+		case V4L2_PIX_FMT_NV16:
+			format->fmt.pix.bytesperline = ALIGN(format->fmt.pix.width, self->halign);
+			format->fmt.pix.sizeimage = format->fmt.pix.bytesperline * ALIGN(format->fmt.pix.height, self->valign) * 2;
+			break;
+
+		case V4L2_PIX_FMT_P010:
+			format->fmt.pix.bytesperline = ALIGN(format->fmt.pix.width * 2, self->halign);
+			format->fmt.pix.sizeimage = format->fmt.pix.bytesperline * ALIGN(format->fmt.pix.height, self->valign) * 3 / 2;
+			break;
+
+		case QVIO_PIX_FMT_V210:
+			format->fmt.pix.bytesperline = ALIGN(QVIO_V210_STRIDE(format->fmt.pix.width), self->halign);
+			format->fmt.pix.sizeimage = format->fmt.pix.bytesperline * ALIGN(format->fmt.pix.height, self->valign);
+			break;
+
 		default:
 			pr_err("invalid value, format->fmt.pix.pixelformat=%d", (int)format->fmt.pix.pixelformat);
 			err = -EINVAL;
@@ -462,6 +754,7 @@ static int __ioctl_s_fmt(struct file *file, void *fh, struct v4l2_format *format
 	case V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE:
 		switch(format->fmt.pix_mp.pixelformat) {
 		case V4L2_PIX_FMT_YUYV:
+		case V4L2_PIX_FMT_UYVY:
 			format->fmt.pix_mp.num_planes = 1;
 			format->fmt.pix_mp.plane_fmt[0].bytesperline = ALIGN(format->fmt.pix_mp.width * 2, self->halign);
 			format->fmt.pix_mp.plane_fmt[0].sizeimage =
@@ -485,6 +778,32 @@ static int __ioctl_s_fmt(struct file *file, void *fh, struct v4l2_format *format
 				format->fmt.pix_mp.plane_fmt[0].bytesperline * ALIGN(format->fmt.pix_mp.height * 3 / 2, self->valign);
 			break;
 
+		case V4L2_PIX_FMT_NV16:
+			format->fmt.pix_mp.num_planes = 2;
+			format->fmt.pix_mp.plane_fmt[0].bytesperline = ALIGN(format->fmt.pix_mp.width, self->halign);
+			format->fmt.pix_mp.plane_fmt[0].sizeimage =
+				format->fmt.pix_mp.plane_fmt[0].bytesperline * ALIGN(format->fmt.pix_mp.height, self->valign);
+			format->fmt.pix_mp.plane_fmt[1].bytesperline = format->fmt.pix_mp.plane_fmt[0].bytesperline;
+			format->fmt.pix_mp.plane_fmt[1].sizeimage = format->fmt.pix_mp.plane_fmt[0].sizeimage;
+			break;
+
+		case V4L2_PIX_FMT_P010:
+			format->fmt.pix_mp.num_planes = 2;
+			format->fmt.pix_mp.plane_fmt[0].bytesperline = ALIGN(format->fmt.pix_mp.width * 2, self->halign);
+			format->fmt.pix_mp.plane_fmt[0].sizeimage =
+				format->fmt.pix_mp.plane_fmt[0].bytesperline * ALIGN(format->fmt.pix_mp.height, self->valign);
+			format->fmt.pix_mp.plane_fmt[1].bytesperline = format->fmt.pix_mp.plane_fmt[0].bytesperline;
+			format->fmt.pix_mp.plane_fmt[1].sizeimage =
+				format->fmt.pix_mp.plane_fmt[1].bytesperline * ALIGN(format->fmt.pix_mp.height, self->valign) / 2;
+			break;
+
+		case QVIO_PIX_FMT_V210:
+			format->fmt.pix_mp.num_planes = 1;
+			format->fmt.pix_mp.plane_fmt[0].bytesperline = ALIGN(QVIO_V210_STRIDE(format->fmt.pix_mp.width), self->halign);
+			format->fmt.pix_mp.plane_fmt[0].sizeimage =
+				format->fmt.pix_mp.plane_fmt[0].bytesperline * ALIGN(format->fmt.pix_mp.height, self->valign);
+			break;
+
 		default:
 			pr_err("invalid value, format->fmt.pix_mp.pixelformat=%d", (int)format->fmt.pix_mp.pixelformat);
 			err = -EINVAL;
@@ -573,6 +892,11 @@ static int __ioctl_enum_input(struct file *file, void *fh, struct v4l2_input *in
 		input->std = 0;
 		input->status = 0;
 		input->capabilities = 0;
+		if(self->source.started) {
+			input->capabilities = V4L2_IN_CAP_DV_TIMINGS;
+			if(! qvio_source_has_signal(&self->source))
+				input->status = V4L2_IN_ST_NO_SIGNAL;
+		}
 		break;
 
 	default:
@@ -753,9 +1077,28 @@ err0:
 	return err;
 }
 
+static int __frame_decimate(struct v4l2_fract* timeperframe) {
+	int i, decimate, best;
+
+	if(timeperframe->numerator == 0 || timeperframe->denominator == 0)
+		return 1;
+
+	decimate = (int)min_t(u64, QVIO_MAX_DECIMATE,
+		DIV_ROUND_CLOSEST_ULL((u64)timeperframe->numerator * QVIO_FRAME_RATE, timeperframe->denominator));
+
+	best = 0;
+	for(i = 1;i < ARRAY_SIZE(__frame_decimations);i++) {
+		if(abs(__frame_decimations[i] - decimate) < abs(__frame_decimations[best] - decimate))
+			best = i;
+	}
+
+	return __frame_decimations[best];
+}
+
 static int __ioctl_s_parm(struct file *file, void *fh, struct v4l2_streamparm *param) {
 	int err;
 	struct qvio_video* self = video_drvdata(file);
+	int decimate, div;
 
 	pr_info("\n");
 
@@ -766,7 +1109,28 @@ static int __ioctl_s_parm(struct file *file, void *fh, struct v4l2_streamparm *p
 		goto err0;
 	}
 
+	// user-job nodes have no engine behind, any interval goes, e.g. 1001/60000, latched at STREAMON
+	if(self->user_job_ctrl.enable) {
+		if(param->parm.capture.timeperframe.numerator == 0 || param->parm.capture.timeperframe.denominator == 0) {
+			param->parm.capture.timeperframe.numerator = 1;
+			param->parm.capture.timeperframe.denominator = QVIO_FRAME_RATE;
+		}
+		param->parm.capture.capability = V4L2_CAP_TIMEPERFRAME;
+
+		self->current_parm = *param;
+
+		return 0;
+	}
+
+	// snap to the nearest supported interval, decimation is latched at STREAMON
+	decimate = __frame_decimate(&param->parm.capture.timeperframe);
+	div = gcd(decimate, QVIO_FRAME_RATE);
+	param->parm.capture.capability = V4L2_CAP_TIMEPERFRAME;
+	param->parm.capture.timeperframe.numerator = decimate / div;
+	param->parm.capture.timeperframe.denominator = QVIO_FRAME_RATE / div;
+
 	self->current_parm = *param;
+	self->queue.decimate = decimate;
 
 	return 0;
 
@@ -780,12 +1144,23 @@ static int __ioctl_enum_framesizes(struct file *file, void *fh, struct v4l2_frms
 
 	pr_info("\n");
 
+	if(! __fmt_supported(self, frame_sizes->pixel_format)) {
+		pr_err("unsupported value, frame_sizes->pixel_format=0x%X\n", (int)frame_sizes->pixel_format);
+		err = -EINVAL;
+
+		goto err0;
+	}
+
 	switch(frame_sizes->index) {
 	case 0:
 		switch(frame_sizes->pixel_format) {
 		case V4L2_PIX_FMT_YUYV:
 		case V4L2_PIX_FMT_NV12:
 		case V4L2_PIX_FMT_M420:
+		case V4L2_PIX_FMT_UYVY:
+		case V4L2_PIX_FMT_NV16:
+		case V4L2_PIX_FMT_P010:
+		case QVIO_PIX_FMT_V210:
 			frame_sizes->type = V4L2_FRMSIZE_TYPE_STEPWISE;
 			frame_sizes->stepwise.min_width = 64;
 			frame_sizes->stepwise.max_width = 4096;
@@ -821,31 +1196,42 @@ err0:
 static int __ioctl_enum_frameintervals(struct file *file, void *fh, struct v4l2_frmivalenum *frame_intervals) {
 	int err;
 	struct qvio_video* self = video_drvdata(file);
+	int decimate, div;
 
 	pr_info("\n");
 
-	switch(frame_intervals->index) {
-	case 0:
-		switch(frame_intervals->pixel_format) {
-		case V4L2_PIX_FMT_YUYV:
-		case V4L2_PIX_FMT_NV12:
-		case V4L2_PIX_FMT_M420:
-			frame_intervals->type = V4L2_FRMIVAL_TYPE_DISCRETE;
-			frame_intervals->discrete.numerator = 1;
-			frame_intervals->discrete.denominator = 60;
-			break;
+	if(frame_intervals->index >= ARRAY_SIZE(__frame_decimations)) {
+		pr_err("unexpected value, frame_intervals->index=%d\n", (int)frame_intervals->index);
+		err = -EINVAL;
 
-		default:
-			pr_err("unexpected value, frame_intervals->pixel_format=0x%X\n", (int)frame_intervals->pixel_format);
-			err = -EINVAL;
+		goto err0;
+	}
 
-			goto err0;
-			break;
-		}
+	if(! __fmt_supported(self, frame_intervals->pixel_format)) {
+		pr_err("unsupported value, frame_intervals->pixel_format=0x%X\n", (int)frame_intervals->pixel_format);
+		err = -EINVAL;
+
+		goto err0;
+	}
+
+	switch(frame_intervals->pixel_format) {
+	case V4L2_PIX_FMT_YUYV:
+	case V4L2_PIX_FMT_NV12:
+	case V4L2_PIX_FMT_M420:
+	case V4L2_PIX_FMT_UYVY:
+	case V4L2_PIX_FMT_NV16:
+	case V4L2_PIX_FMT_P010:
+	case QVIO_PIX_FMT_V210:
+		decimate = __frame_decimations[frame_intervals->index];
+		div = gcd(decimate, QVIO_FRAME_RATE);
+
+		frame_intervals->type = V4L2_FRMIVAL_TYPE_DISCRETE;
+		frame_intervals->discrete.numerator = decimate / div;
+		frame_intervals->discrete.denominator = QVIO_FRAME_RATE / div;
 		break;
 
 	default:
-		pr_err("unexpected value, frame_intervals->index=%d\n", (int)frame_intervals->index);
+		pr_err("unexpected value, frame_intervals->pixel_format=0x%X\n", (int)frame_intervals->pixel_format);
 		err = -EINVAL;
 
 		goto err0;
@@ -858,6 +1244,144 @@ err0:
 	return err;
 }
 
+static int __ioctl_subscribe_event(struct v4l2_fh *fh, const struct v4l2_event_subscription *sub) {
+	struct qvio_video* self = video_get_drvdata(fh->vdev);
+
+	switch(sub->type) {
+	case QVIO_EVENT_SLICE:
+		return v4l2_event_subscribe(fh, sub, QVIO_MAX_SLICES * 2, NULL);
+
+	case V4L2_EVENT_SOURCE_CHANGE:
+		return v4l2_src_change_event_subscribe(fh, sub);
+
+	case QVIO_EVENT_MCU_TABLE:
+		return v4l2_event_subscribe(fh, sub, 1, NULL);
+
+	case V4L2_EVENT_FRAME_SYNC:
+		// never at the end of a frame, only from a start-of-frame source
+		if(! qvio_queue_has_frame_sync(&self->queue))
+			return -EINVAL;
+
+		return v4l2_event_subscribe(fh, sub, 4, NULL);
+
+	default:
+		break;
+	}
+
+	return v4l2_ctrl_subscribe_event(fh, sub);
+}
+
+static int __ioctl_query_dv_timings(struct file *file, void *fh, struct v4l2_dv_timings *timings) {
+	int err;
+	struct qvio_video* self = video_drvdata(file);
+
+	err = qvio_source_query(&self->source, timings);
+	if(err && err != -ENOLINK && err != -ENODATA) {
+		pr_err("qvio_source_query() failed, err=%d\n", err);
+		err = -ENOLCK;
+	}
+
+	return err;
+}
+
+static int __ioctl_g_dv_timings(struct file *file, void *fh, struct v4l2_dv_timings *timings) {
+	struct qvio_video* self = video_drvdata(file);
+
+	return qvio_source_g_timings(&self->source, timings);
+}
+
+static int __ioctl_reqbufs(struct file *file, void *fh, struct v4l2_requestbuffers *p) {
+	int err;
+	struct qvio_video* self = video_drvdata(file);
+	struct vb2_queue* queue = self->vdev->queue;
+	unsigned int num_buffers;
+
+	// the daemon drops all its registrations in one round-trip before vb2 frees the buffers
+	num_buffers = qvio_queue_num_buffers(&self->queue);
+	if(num_buffers && ! vb2_is_streaming(queue) &&
+		(! queue->owner || queue->owner == file->private_data)) {
+		err = qvio_user_job_buf_cleanup_batch(&self->user_job_ctrl, queue, 0, num_buffers);
+		if(err) {
+			pr_warn("qvio_user_job_buf_cleanup_batch() failed, err=%d\n", err);
+		}
+	}
+
+	err = vb2_ioctl_reqbufs(file, fh, p);
+	if(err)
+		return err;
+
+	num_buffers = qvio_queue_num_buffers(&self->queue);
+	if(num_buffers) {
+		err = qvio_user_job_buf_init_batch(&self->user_job_ctrl, queue, 0, num_buffers, qvio_queue_buf_init_done);
+		if(err) {
+			pr_warn("qvio_user_job_buf_init_batch() failed, err=%d\n", err);
+		}
+	}
+
+	return 0;
+}
+
+static int __ioctl_create_bufs(struct file *file, void *fh, struct v4l2_create_buffers *p) {
+	int err;
+	struct qvio_video* self = video_drvdata(file);
+
+	err = vb2_ioctl_create_bufs(file, fh, p);
+	if(err)
+		return err;
+
+	if(p->count) {
+		err = qvio_user_job_buf_init_batch(&self->user_job_ctrl, self->vdev->queue, p->index, p->count, qvio_queue_buf_init_done);
+		if(err) {
+			pr_warn("qvio_user_job_buf_init_batch() failed, err=%d\n", err);
+		}
+	}
+
+	return 0;
+}
+
+static int __video_open(struct file *file) {
+	int err;
+	struct qvio_video* self = video_drvdata(file);
+
+	err = v4l2_fh_open(file);
+	if(err)
+		return err;
+
+	qvio_source_open(&self->source);
+
+	return 0;
+}
+
+static int __video_release(struct file *file) {
+	int err;
+	struct qvio_video* self = video_drvdata(file);
+	struct vb2_queue* queue = self->vdev->queue;
+	unsigned int num_buffers;
+
+	qvio_source_close(&self->source);
+
+	// vb2_fop_release() would stop and free behind the daemon's back
+	mutex_lock(queue->lock);
+	num_buffers = qvio_queue_num_buffers(&self->queue);
+	if(num_buffers && queue->owner == file->private_data) {
+		vb2_streamoff(queue, queue->type);
+
+		err = qvio_user_job_buf_cleanup_batch(&self->user_job_ctrl, queue, 0, num_buffers);
+		if(err) {
+			pr_warn("qvio_user_job_buf_cleanup_batch() failed, err=%d\n", err);
+		}
+	}
+	mutex_unlock(queue->lock);
+
+	return vb2_fop_release(file);
+}
+
+static int __video_mmap(struct file *file, struct vm_area_struct *vma) {
+	struct qvio_video* self = video_drvdata(file);
+
+	return qvio_queue_mmap(&self->queue, vma);
+}
+
 static int __anon_fd(const char* name, const struct file_operations *fops, void *priv, int flags) {
 	int err;
 	int fd;
@@ -901,8 +1425,22 @@ static long __ioctl_default(struct file *file, void *fh, bool valid_prio, unsign
 	switch(cmd) {
 	case QVID_IOC_USER_JOB_FD: {
 		int* pFd = (int*)arg;
+		struct qvio_user_job_consumer* consumer;
+
+		// one consumer per fd, each daemon worker asks for its own
+		consumer = qvio_user_job_consumer_new(&self->user_job_ctrl);
+		if(! consumer) {
+			ret = -ENOMEM;
+			break;
+		}
 
-		*pFd = __anon_fd("qvio-user-job", self->user_job_ctrl.ctrl_fops, &self->user_job_ctrl, O_RDONLY | O_CLOEXEC);
+		// read-write, the job rings are mapped shared and writable
+		*pFd = __anon_fd("qvio-user-job", self->user_job_ctrl.ctrl_fops, consumer, O_RDWR | O_CLOEXEC);
+		if(*pFd < 0) {
+			qvio_user_job_consumer_free(consumer);
+			ret = *pFd;
+			break;
+		}
 		ret = 0;
 
 		pr_info("fd=%d\n", *pFd);
@@ -913,6 +1451,38 @@ static long __ioctl_default(struct file *file, void *fh, bool valid_prio, unsign
 		ret = qvio_video_buf_done(self);
 		break;
 
+	case QVID_IOC_S_GROUP:
+		ret = qvio_video_s_group(self, *(int*)arg);
+		break;
+
+	case QVID_IOC_G_DEADLINE:
+		ret = qvio_video_g_deadline(self, (struct qvio_deadline*)arg);
+		break;
+
+	case QVID_IOC_S_DEADLINE:
+		ret = qvio_video_s_deadline(self, (struct qvio_deadline*)arg);
+		break;
+
+	case QVID_IOC_G_FRAME_CLOCK:
+		ret = qvio_video_g_frame_clock(self, (struct qvio_frame_clock*)arg);
+		break;
+
+	case QVID_IOC_S_FRAME_CLOCK:
+		ret = qvio_video_s_frame_clock(self, (struct qvio_frame_clock*)arg);
+		break;
+
+	case QVID_IOC_G_MCU_TABLE:
+		ret = qvio_source_g_mcu_table(&self->source, (struct qvio_mcu_table*)arg);
+		break;
+
+	case QVID_IOC_G_WATCHDOG:
+		ret = qvio_video_g_watchdog(self, (struct qvio_watchdog*)arg);
+		break;
+
+	case QVID_IOC_S_WATCHDOG:
+		ret = qvio_video_s_watchdog(self, (struct qvio_watchdog*)arg);
+		break;
+
 	default:
 		ret = -ENOIOCTLCMD;
 		break;
@@ -3,6 +3,7 @@
 
 #include "queue.h"
 #include "user_job.h"
+#include "source.h"
 #include "device.h"
 
 #include <media/v4l2-device.h>
@@ -31,6 +32,9 @@ struct qvio_video {
 	// user job
 	struct qvio_user_job_ctrl user_job_ctrl;
 
+	// input signal, capture nodes only
+	struct qvio_source source;
+
 	// xdma
 	int channel;
 };
@@ -59,5 +63,12 @@ int qvio_video_enum_frameintervals(struct qvio_video* self, struct v4l2_frmivale
 
 // proprietary v4l2 ioctl
 long qvio_video_buf_done(struct qvio_video* self);
+long qvio_video_s_group(struct qvio_video* self, int enable);
+long qvio_video_g_deadline(struct qvio_video* self, struct qvio_deadline* deadline);
+long qvio_video_s_deadline(struct qvio_video* self, struct qvio_deadline* deadline);
+long qvio_video_g_frame_clock(struct qvio_video* self, struct qvio_frame_clock* frame_clock);
+long qvio_video_s_frame_clock(struct qvio_video* self, struct qvio_frame_clock* frame_clock);
+long qvio_video_g_watchdog(struct qvio_video* self, struct qvio_watchdog* watchdog);
+long qvio_video_s_watchdog(struct qvio_video* self, struct qvio_watchdog* watchdog);
 
 #endif // __QVIO_VIDEO_H__
\ No newline at end of file
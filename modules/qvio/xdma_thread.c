@@ -23,6 +23,7 @@
 
 #include <linux/kernel.h>
 #include <linux/slab.h>
+#include <uapi/linux/sched/types.h>
 
 
 /* ********************* global variables *********************************** */
@@ -203,14 +204,43 @@ int xdma_kthread_stop(struct xdma_kthread *thp)
 
 
 
+int xdma_kthread_set_fifo(struct task_struct *task, int prio, int cpu)
+{
+	struct sched_attr attr = {
+		.size = sizeof(attr),
+		.sched_policy = SCHED_FIFO,
+		.sched_priority = prio,
+	};
+	int rv;
+
+	if (cpu >= 0) {
+		rv = set_cpus_allowed_ptr(task, cpumask_of(cpu));
+		if (rv < 0) {
+			pr_err("%s, cpu %d, affinity err %d.\n",
+				task->comm, cpu, rv);
+			return rv;
+		}
+	}
+
+	rv = sched_setattr_nocheck(task, &attr);
+	if (rv < 0)
+		pr_err("%s, prio %d, SCHED_FIFO err %d.\n",
+			task->comm, prio, rv);
+
+	return rv;
+}
+
 void xdma_thread_remove_work(struct xdma_engine *engine)
 {
 	struct xdma_kthread *cmpl_thread;
 	unsigned long flags;
+	int rt;
 
 	spin_lock_irqsave(&engine->lock, flags);
 	cmpl_thread = engine->cmplthp;
 	engine->cmplthp = NULL;
+	rt = engine->cmplthp_rt;
+	engine->cmplthp_rt = 0;
 
 //	pr_debug("%s removing from thread %s, %u.\n",
 //		descq->conf.name, cmpl_thread ? cmpl_thread->name : "?",
@@ -231,6 +261,12 @@ void xdma_thread_remove_work(struct xdma_engine *engine)
 		list_del(&engine->cmplthp_list);
 		cmpl_thread->work_cnt--;
 		unlock_thread(cmpl_thread);
+
+		/* the engine's own thread goes with it */
+		if (rt) {
+			xdma_kthread_stop(cmpl_thread);
+			kfree(cmpl_thread);
+		}
 	}
 }
 
@@ -273,6 +309,56 @@ void xdma_thread_add_work(struct xdma_engine *engine)
 	spin_unlock_irqrestore(&engine->lock, flags);
 }
 
+int xdma_thread_add_work_rt(struct xdma_engine *engine, int prio, int cpu)
+{
+	struct xdma_kthread *thp;
+	unsigned long flags;
+	int rv;
+
+	thp = kzalloc(sizeof(struct xdma_kthread), GFP_KERNEL);
+	if (!thp) {
+		pr_err("OOM, %s cmpl thread.\n", engine->name);
+		return -ENOMEM;
+	}
+
+	thp->cpu = cpu;
+	thp->timeout = 0;
+	thp->fproc = xdma_thread_cmpl_status_proc;
+	thp->fpending = xdma_thread_cmpl_status_pend;
+	rv = xdma_kthread_start(thp, "cmpl_rt_th",
+			engine->xdev->idx * XDMA_CHANNEL_NUM_MAX +
+			engine->channel);
+	if (rv < 0)
+		goto free_thread;
+
+	/* bound already by xdma_kthread_start() */
+	rv = xdma_kthread_set_fifo(thp->task, prio, -1);
+	if (rv < 0)
+		goto stop_thread;
+
+	lock_thread(thp);
+	list_add_tail(&engine->cmplthp_list, &thp->work_list);
+	engine->intr_work_cpu = cpu;
+	thp->work_cnt++;
+	unlock_thread(thp);
+
+	pr_info("%s 0x%p assigned to cmpl status thread %s, prio %d, cpu %d.\n",
+		engine->name, engine, thp->name, prio, cpu);
+
+	spin_lock_irqsave(&engine->lock, flags);
+	engine->cmplthp = thp;
+	engine->cmplthp_rt = 1;
+	spin_unlock_irqrestore(&engine->lock, flags);
+
+	return 0;
+
+stop_thread:
+	xdma_kthread_stop(thp);
+free_thread:
+	kfree(thp);
+	return rv;
+}
+
 int xdma_threads_create(unsigned int num_threads)
 {
 	struct xdma_kthread *thp;
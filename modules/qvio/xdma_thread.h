@@ -144,4 +144,30 @@ void xdma_thread_remove_work(struct xdma_engine *engine);
  *****************************************************************************/
 void xdma_thread_add_work(struct xdma_engine *engine);
 
+/*****************************************************************************/
+/**
+ * xdma_thread_add_work_rt() - give the engine its own SCHED_FIFO work thread
+ *                             instead of sharing one of the created threads,
+ *                             undone by xdma_thread_remove_work()
+ *
+ * @param[in]	engine:	pointer to xdma_engine
+ * @param[in]	prio:	SCHED_FIFO priority
+ * @param[in]	cpu:	cpu the thread is bound to
+ *
+ * @return	0 on success, < 0 on failure
+ *****************************************************************************/
+int xdma_thread_add_work_rt(struct xdma_engine *engine, int prio, int cpu);
+
+/*****************************************************************************/
+/**
+ * xdma_kthread_set_fifo() - make a kernel thread SCHED_FIFO
+ *
+ * @param[in]	task:	the thread
+ * @param[in]	prio:	SCHED_FIFO priority
+ * @param[in]	cpu:	cpu the thread is moved to, < 0 to leave it
+ *
+ * @return	0 on success, < 0 on failure
+ *****************************************************************************/
+int xdma_kthread_set_fifo(struct task_struct *task, int prio, int cpu);
+
 #endif /* #ifndef __XDMA_KTHREAD_H__ */
@@ -24,6 +24,7 @@
 #include <deque>
 #include <atomic>
 #include <memory>
+#include <future>
 
 #include "qvio.h"
 
@@ -93,7 +94,11 @@ namespace __03_qvio_ctl__ {
 		void VidUserJob_START_STREAMING(const qvio_user_job& user_job, qvio_user_job_done& user_job_done);
 		void VidUserJob_STOP_STREAMING(const qvio_user_job& user_job, qvio_user_job_done& user_job_done);
 		void VidUserJob_BUF_DONE(const qvio_user_job& user_job, qvio_user_job_done& user_job_done);
+		void VidUserJob_BUF_INIT_BATCH(const qvio_user_job& user_job, qvio_user_job_done& user_job_done);
+		void VidUserJob_BUF_CLEANUP_BATCH(const qvio_user_job& user_job, qvio_user_job_done& user_job_done);
 		void VidUserJob_ERROR(const qvio_user_job& user_job, qvio_user_job_done& user_job_done);
+		void VidDstBufferMap(int nIndex);
+		void VidDstBufferUnmap(int nIndex);
 
 		// video source
 		int nVidSrcFd;
@@ -104,6 +109,20 @@ namespace __03_qvio_ctl__ {
 		std::mutex oSrcBufferQMutex;
 		std::deque<v4l2_buffer> oSrcBufferQ; // defer tasks for done-ioctl
 		void VidSrc_Main();
+
+		// passthrough, same format on both sides, source buffer i is lent as qvio buffer i
+		// from the source DQBUF until the consumer queues the qvio buffer again, no copies
+		bool bVidPassthrough;
+		struct lend_buffer {
+			int nDmaBuf; // VIDIOC_EXPBUF of the source buffer
+			bool bPending; // BUF_DONE job waiting for the source to fill it
+			__u16 nSequence;
+		};
+		std::vector<lend_buffer> oLendBuffers;
+		int VidSrc_PassthroughOpen(int nCount);
+		void VidSrc_PassthroughClose();
+		void VidSrc_PassthroughMain();
+		bool VidUserJob_BUF_DONE_Passthrough(const qvio_user_job& user_job);
 	};
 
 	App::App(int argc, char **argv) : argc(argc), argv(argv) {
@@ -123,6 +142,7 @@ namespace __03_qvio_ctl__ {
 			nVidFd = -1;
 			nVidUserJobFd = -1;
 			nVidSrcFd = -1;
+			bVidPassthrough = false;
 
 			nMemory = V4L2_MEMORY_MMAP;
 			nBufType = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -261,6 +281,9 @@ namespace __03_qvio_ctl__ {
 				if (FD_ISSET(nVidUserJobFd, &readfds)) {
 					qvio_user_job user_job;
 					qvio_user_job_done user_job_done;
+					bool bDeferred = false;
+
+					memset(&user_job_done, 0, sizeof(qvio_user_job_done));
 
 					err = ioctl(nVidUserJobFd, QVID_IOC_USER_JOB_GET, &user_job);
 					if(err) {
@@ -295,14 +318,35 @@ namespace __03_qvio_ctl__ {
 						break;
 
 					case QVIO_USER_JOB_ID_BUF_DONE:
+						// answered by the source thread once the lent buffer is filled
+						if(bVidPassthrough) {
+							bDeferred = VidUserJob_BUF_DONE_Passthrough(user_job);
+							if(bDeferred)
+								break;
+
+							user_job_done.u.buf_done.flags = -1;
+							break;
+						}
+
 						VidUserJob_BUF_DONE(user_job, user_job_done);
 						break;
 
+					case QVIO_USER_JOB_ID_BUF_INIT_BATCH:
+						VidUserJob_BUF_INIT_BATCH(user_job, user_job_done);
+						break;
+
+					case QVIO_USER_JOB_ID_BUF_CLEANUP_BATCH:
+						VidUserJob_BUF_CLEANUP_BATCH(user_job, user_job_done);
+						break;
+
 					default:
 						VidUserJob_ERROR(user_job, user_job_done);
 						break;
 					}
 
+					if(bDeferred)
+						continue;
+
 					user_job_done.id = user_job.id;
 					user_job_done.sequence = user_job.sequence;
 
@@ -342,6 +386,13 @@ namespace __03_qvio_ctl__ {
 			oVidDstFormat.fmt.pix.pixelformat,
 			(int)oVidDstFormat.fmt.pix.sizeimage,
 			(int)oVidDstFormat.fmt.pix.bytesperline);
+
+		// nothing to scale or convert, the source buffers go through as they are
+		bVidPassthrough = (oVidDstFormat.fmt.pix.width == oVidSrcFormat.fmt.pix.width &&
+			oVidDstFormat.fmt.pix.height == oVidSrcFormat.fmt.pix.height &&
+			oVidDstFormat.fmt.pix.pixelformat == oVidSrcFormat.fmt.pix.pixelformat);
+
+		LOGD("bVidPassthrough=%d", (int)bVidPassthrough);
 	}
 
 	void App::VidUserJob_QUEUE_SETUP(const qvio_user_job& user_job, qvio_user_job_done& user_job_done) {
@@ -357,14 +408,88 @@ namespace __03_qvio_ctl__ {
 	}
 
 	void App::VidUserJob_BUF_INIT(const qvio_user_job& user_job, qvio_user_job_done& user_job_done) {
-		int err;
-
 		LOGD("%s(%d): index=%d", __FUNCTION__, (int)user_job.sequence, user_job.u.buf_init.index);
 
+		user_job_done.u.buf_init.dma_buf = -1;
+
+#if 1
+		VidDstBufferMap((int)user_job.u.buf_init.index);
+#endif
+	}
+
+	void App::VidUserJob_BUF_CLEANUP(const qvio_user_job& user_job, qvio_user_job_done& user_job_done) {
+		LOGD("%s(%d): index=%d", __FUNCTION__, (int)user_job.sequence, user_job.u.buf_cleanup.index);
+
 #if 1
-		int nIndex = (int)user_job.u.buf_init.index;
+		VidDstBufferUnmap((int)user_job.u.buf_cleanup.index);
+#endif
+	}
+
+	void App::VidUserJob_BUF_INIT_BATCH(const qvio_user_job& user_job, qvio_user_job_done& user_job_done) {
+		int err;
+
+		LOGD("%s(%d): count=%d", __FUNCTION__, (int)user_job.sequence, (int)user_job.u.buf_init_batch.count);
+
+		for(unsigned int i = 0;i < QVIO_USER_JOB_MAX_BATCH;i++)
+			user_job_done.u.buf_init_batch.dma_buf[i] = -1;
+
+		// the source buffers are set up here already, their dma-bufs back the qvio buffers
+		if(bVidPassthrough) {
+			// a previous session's source thread and fds go first
+			std::promise<void> oFlushed;
+			oDeferredTasks.AddTask([&]() {
+				oFlushed.set_value();
+			});
+			oFlushed.get_future().wait();
+		}
+
+		if(bVidPassthrough && nVidSrcFd == -1) {
+			err = VidSrc_PassthroughOpen((int)oMbuffers.size());
+			if(err) {
+				LOGW("%s(%d): VidSrc_PassthroughOpen() failed, err=%d, fallback to copy", __FUNCTION__, __LINE__, err);
+				bVidPassthrough = false;
+			}
+		}
+
+		for(unsigned int i = 0;i < user_job.u.buf_init_batch.count;i++) {
+			int nIndex = user_job.u.buf_init_batch.bufs[i].index;
+
+			if(! bVidPassthrough) {
+				VidDstBufferMap(nIndex);
+				continue;
+			}
+
+			if(nIndex >= 0 && nIndex < oLendBuffers.size())
+				user_job_done.u.buf_init_batch.dma_buf[i] = oLendBuffers[nIndex].nDmaBuf;
+		}
+
+		if(bVidPassthrough) {
+			user_job_done.u.buf_init_batch.offset[0] = 0;
+			user_job_done.u.buf_init_batch.pitch[0] = oVidSrcFormat.fmt.pix.bytesperline;
+			user_job_done.u.buf_init_batch.psize[0] = oVidSrcFormat.fmt.pix.sizeimage;
+		}
+	}
+
+	void App::VidUserJob_BUF_CLEANUP_BATCH(const qvio_user_job& user_job, qvio_user_job_done& user_job_done) {
+		LOGD("%s(%d): count=%d", __FUNCTION__, (int)user_job.sequence, (int)user_job.u.buf_cleanup_batch.count);
+
+		for(unsigned int i = 0;i < user_job.u.buf_cleanup_batch.count;i++) {
+			VidDstBufferUnmap(user_job.u.buf_cleanup_batch.index[i]);
+		}
+
+		// the driver holds its own dma-buf references until the buffers are freed,
+		// after the source thread is joined at STOP_STREAMING
+		oDeferredTasks.AddTask([&]() {
+			if(nVidSrcFd != -1 && bVidPassthrough)
+				VidSrc_PassthroughClose();
+		});
+	}
+
+	void App::VidDstBufferMap(int nIndex) {
 		if(nIndex >= 0 && nIndex < oMbuffers.size()) {
 			oDeferredTasks.AddTask([&, nIndex]() {
+				int err;
+
 				LOGD("VIDIOC_QUERYBUF(%d)...", nIndex);
 
 				v4l2_buffer buffer;
@@ -402,18 +527,13 @@ namespace __03_qvio_ctl__ {
 					buffer.index, mbuffer.pVirAddr[0], mbuffer.nLength[0]);
 			});
 		}
-#endif
 	}
 
-	void App::VidUserJob_BUF_CLEANUP(const qvio_user_job& user_job, qvio_user_job_done& user_job_done) {
-		int err;
-
-		LOGD("%s(%d): index=%d", __FUNCTION__, (int)user_job.sequence, user_job.u.buf_cleanup.index);
-
-#if 1
-		int nIndex = (int)user_job.u.buf_init.index;
+	void App::VidDstBufferUnmap(int nIndex) {
 		if(nIndex >= 0 && nIndex < oMbuffers.size()) {
 			oDeferredTasks.AddTask([&, nIndex]() {
+				int err;
+
 				LOGD("munmap BUFFER(%d)...", nIndex);
 
 				mmap_buffer& mbuffer = oMbuffers[nIndex];
@@ -434,7 +554,6 @@ namespace __03_qvio_ctl__ {
 				memset(&mbuffer, 0, sizeof(mmap_buffer));
 			});
 		}
-#endif
 	}
 
 	void App::VidUserJob_START_STREAMING(const qvio_user_job& user_job, qvio_user_job_done& user_job_done) {
@@ -442,7 +561,7 @@ namespace __03_qvio_ctl__ {
 
 		oDeferredTasks.AddTask([&]() {
 			bVidSrcDone.store(false);
-			std::thread t(std::bind(&App::VidSrc_Main, this));
+			std::thread t(std::bind(bVidPassthrough ? &App::VidSrc_PassthroughMain : &App::VidSrc_Main, this));
 			oVidSrcThread.swap(t);
 		});
 	}
@@ -617,6 +736,238 @@ namespace __03_qvio_ctl__ {
 		}
 	}
 
+	bool App::VidUserJob_BUF_DONE_Passthrough(const qvio_user_job& user_job) {
+		int err;
+		int nIndex = (int)user_job.u.buf_done.index;
+
+		if(nIndex < 0 || nIndex >= oLendBuffers.size()) {
+			LOGE("%s(%d): unexpected value, nIndex=%d", __FUNCTION__, __LINE__, nIndex);
+			return false;
+		}
+
+		{
+			std::lock_guard<std::mutex> _{oSrcBufferQMutex};
+
+			oLendBuffers[nIndex].bPending = true;
+			oLendBuffers[nIndex].nSequence = user_job.sequence;
+		}
+
+		// the consumer is through with it, the source may fill it again
+		v4l2_buffer buffer;
+		memset(&buffer, 0, sizeof(v4l2_buffer));
+		buffer.index = nIndex;
+		buffer.type = oVidSrcFormat.type;
+		buffer.memory = V4L2_MEMORY_MMAP;
+		err = ioctl(nVidSrcFd, VIDIOC_QBUF, &buffer);
+		if(err) {
+			err = errno;
+			LOGE("%s(%d): ioctl(VIDIOC_QBUF) failed, err=%d", __FUNCTION__, __LINE__, err);
+
+			std::lock_guard<std::mutex> _{oSrcBufferQMutex};
+			oLendBuffers[nIndex].bPending = false;
+			return false;
+		}
+
+		return true;
+	}
+
+	int App::VidSrc_PassthroughOpen(int nCount) {
+		int err;
+
+		LOGD("%s(%d): nCount=%d", __FUNCTION__, __LINE__, nCount);
+
+		switch(1) { case 1:
+			nVidSrcFd = open("/dev/video0", O_RDWR | O_NONBLOCK);
+			if(nVidSrcFd == -1) {
+				err = errno;
+				LOGE("%s(%d): open() failed, err=%d", __FUNCTION__, __LINE__, err);
+				break;
+			}
+
+			err = ioctl(nVidSrcFd, VIDIOC_S_FMT, &oVidSrcFormat);
+			if(err) {
+				err = errno;
+				LOGE("%s(%d): ioctl(VIDIOC_S_FMT) failed, err=%d", __FUNCTION__, __LINE__, err);
+				break;
+			}
+
+			// the qvio buffers take the source layout as it is
+			if(oVidSrcFormat.fmt.pix.bytesperline != oVidDstFormat.fmt.pix.bytesperline) {
+				LOGE("%s(%d): unexpected value, bytesperline=%d != %d", __FUNCTION__, __LINE__,
+					(int)oVidSrcFormat.fmt.pix.bytesperline, (int)oVidDstFormat.fmt.pix.bytesperline);
+				err = EINVAL;
+				break;
+			}
+
+			struct v4l2_requestbuffers requestBuffers;
+			memset(&requestBuffers, 0, sizeof(struct v4l2_requestbuffers));
+			requestBuffers.count = nCount;
+			requestBuffers.type = oVidSrcFormat.type;
+			requestBuffers.memory = V4L2_MEMORY_MMAP;
+			err = ioctl(nVidSrcFd, VIDIOC_REQBUFS, &requestBuffers);
+			if(err) {
+				err = errno;
+				LOGE("%s(%d): ioctl(VIDIOC_REQBUFS) failed, err=%d", __FUNCTION__, __LINE__, err);
+				break;
+			}
+
+			if(requestBuffers.count != nCount) {
+				LOGE("%s(%d): unexpected value, requestBuffers.count=%d != %d", __FUNCTION__, __LINE__,
+					(int)requestBuffers.count, nCount);
+				err = ENOMEM;
+				break;
+			}
+
+			lend_buffer lbuffer = { -1, false, 0 };
+			oLendBuffers.resize(nCount, lbuffer);
+
+			for(int i = 0;i < nCount;i++) {
+				v4l2_exportbuffer expbuf;
+				memset(&expbuf, 0, sizeof(v4l2_exportbuffer));
+				expbuf.type = oVidSrcFormat.type;
+				expbuf.index = i;
+				expbuf.flags = O_RDWR | O_CLOEXEC;
+				err = ioctl(nVidSrcFd, VIDIOC_EXPBUF, &expbuf);
+				if(err) {
+					err = errno;
+					LOGE("%s(%d): ioctl(VIDIOC_EXPBUF) failed, err=%d", __FUNCTION__, __LINE__, err);
+					break;
+				}
+
+				oLendBuffers[i].nDmaBuf = expbuf.fd;
+
+				LOGD("SRC-BUFFER[%d]: dma_buf=%d", i, expbuf.fd);
+			}
+			if(err)
+				break;
+
+			return 0;
+		}
+
+		VidSrc_PassthroughClose();
+
+		return err;
+	}
+
+	void App::VidSrc_PassthroughClose() {
+		int err;
+
+		LOGD("%s(%d):", __FUNCTION__, __LINE__);
+
+		for(auto& lbuffer : oLendBuffers) {
+			if(lbuffer.nDmaBuf != -1)
+				close(lbuffer.nDmaBuf);
+		}
+		oLendBuffers.clear();
+
+		if(nVidSrcFd != -1) {
+			err = close(nVidSrcFd);
+			if(err) {
+				err = errno;
+				LOGE("%s(%d): close() failed, err=%d", __FUNCTION__, __LINE__, err);
+			}
+			nVidSrcFd = -1;
+		}
+	}
+
+	// the source fills lent buffers only, each one goes back to the consumer as it is
+	void App::VidSrc_PassthroughMain() {
+		int err;
+		ZzUtils::FreeStack _FreeStack;
+
+		LOGD("+++%s", __FUNCTION__);
+
+		switch(1) { case 1:
+			__u32 buf_type = oVidSrcFormat.type;
+			err = ioctl(nVidSrcFd, VIDIOC_STREAMON, &buf_type);
+			if(err) {
+				LOGE("%s(%d): ioctl(VIDIOC_STREAMON) failed, err=%d", __FUNCTION__, __LINE__, err);
+				break;
+			}
+			_FreeStack += [&]() {
+				int err;
+
+				__u32 buf_type = oVidSrcFormat.type;
+				err = ioctl(nVidSrcFd, VIDIOC_STREAMOFF, &buf_type);
+				if(err) {
+					LOGE("%s(%d): ioctl(VIDIOC_STREAMOFF) failed, err=%d", __FUNCTION__, __LINE__, err);
+				}
+
+				std::lock_guard<std::mutex> _{oSrcBufferQMutex};
+				for(auto& lbuffer : oLendBuffers)
+					lbuffer.bPending = false;
+			};
+
+			while(! bVidSrcDone.load()) {
+				fd_set readfds;
+				FD_ZERO(&readfds);
+
+				int fd_max = -1;
+				if(nVidSrcFd > fd_max) fd_max = nVidSrcFd;
+				FD_SET(nVidSrcFd, &readfds);
+
+				struct timeval tval;
+				tval.tv_sec  = 0;
+				tval.tv_usec = 500 * 1000LL;
+
+				err = select(fd_max + 1, &readfds, NULL, NULL, &tval);
+				if (err < 0) {
+					LOGE("%s(%d): select() failed! err=%d", __FUNCTION__, __LINE__, err);
+					break;
+				}
+
+				// the consumer may hold every buffer
+				if(err == 0)
+					continue;
+
+				if (FD_ISSET(nVidSrcFd, &readfds)) {
+					v4l2_buffer buffer;
+					memset(&buffer, 0, sizeof(v4l2_buffer));
+					buffer.type = oVidSrcFormat.type;
+					buffer.memory = V4L2_MEMORY_MMAP;
+					err = ioctl(nVidSrcFd, VIDIOC_DQBUF, &buffer);
+					if(err) {
+						err = errno;
+						if(err == EAGAIN)
+							continue;
+
+						LOGE("%s(%d): ioctl(VIDIOC_DQBUF) failed, err=%d", __FUNCTION__, __LINE__, err);
+						break;
+					}
+
+					qvio_user_job_done user_job_done;
+					memset(&user_job_done, 0, sizeof(qvio_user_job_done));
+					user_job_done.id = QVIO_USER_JOB_ID_BUF_DONE;
+					user_job_done.u.buf_done.flags = (buffer.flags & V4L2_BUF_FLAG_ERROR) ? -1 : 0;
+
+					{
+						std::lock_guard<std::mutex> _{oSrcBufferQMutex};
+
+						if(buffer.index >= oLendBuffers.size() || ! oLendBuffers[buffer.index].bPending) {
+							LOGE("%s(%d): unexpected, buffer.index=%d", __FUNCTION__, __LINE__, (int)buffer.index);
+							continue;
+						}
+
+						oLendBuffers[buffer.index].bPending = false;
+						user_job_done.sequence = oLendBuffers[buffer.index].nSequence;
+					}
+
+					// lent to the consumer until it queues the qvio buffer again
+					err = ioctl(nVidUserJobFd, QVID_IOC_USER_JOB_DONE, &user_job_done);
+					if(err) {
+						err = errno;
+						LOGE("%s(%d): ioctl(QVID_IOC_USER_JOB_DONE) failed, err=%d", __FUNCTION__, __LINE__, err);
+						break;
+					}
+				}
+			}
+		}
+
+		_FreeStack.Flush();
+
+		LOGD("---%s", __FUNCTION__);
+	}
+
 	void App::VidUserJob_ERROR(const qvio_user_job& user_job, qvio_user_job_done& user_job_done) {
 		LOGD("%s(%d): id=%d", __FUNCTION__, (int)user_job.sequence, (int)user_job.id);
 	}
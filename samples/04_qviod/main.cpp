@@ -12,6 +12,7 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <poll.h>
 #include <linux/videodev2.h>
 #include <linux/media.h>
 #include <linux/version.h>
@@ -45,8 +46,18 @@ namespace __04_qviod__ {
 		char **argv;
 
 		ZzUtils::FreeStack oFreeStack;
+		const char* pszVidDev; // qvio-rx or qvio-tx node
 		int nVidFd;
 		int nVidUserJobFd;
+		qvio_user_job_rings* pVidUserJobRings;
+
+		// extra user-job fds, one per worker thread, buffer jobs are spread over them
+		int nVidUserJobWorkers;
+		std::vector<std::thread> oVidUserJobWorkers;
+		std::atomic<bool> bVidUserJobQuit;
+
+		// 'p' toggles, no job is answered meanwhile, the driver completes the frames on its deadline
+		std::atomic<bool> bVidUserJobStall;
 
 		App(int argc, char **argv);
 		~App();
@@ -59,7 +70,15 @@ namespace __04_qviod__ {
 		v4l2_format oVidDstFormat;
 		ZzDeferredTasks oDeferredTasks;
 
+		int OpenVidUserJob(int& nFd, qvio_user_job_rings*& pRings);
+		void CloseVidUserJob(int nFd, qvio_user_job_rings* pRings);
 		void VidUserJobHandling();
+		void VidUserJobWorker(int nWorker);
+		int VidUserJobService(int nFd, qvio_user_job_rings* pRings);
+		void VidUserJobDispatch(const qvio_user_job& user_job, qvio_user_job_done& user_job_done);
+		int VidUserJobRingDrain(int nFd, qvio_user_job_rings* pRings);
+		void VidUserJobStats(int nFd, bool bReset);
+		void VidDeadlineStats();
 		void VidUserJob_S_FMT(const qvio_user_job& user_job, qvio_user_job_done& user_job_done);
 		void VidUserJob_QUEUE_SETUP(const qvio_user_job& user_job, qvio_user_job_done& user_job_done);
 		void VidUserJob_BUF_INIT(const qvio_user_job& user_job, qvio_user_job_done& user_job_done);
@@ -67,6 +86,8 @@ namespace __04_qviod__ {
 		void VidUserJob_START_STREAMING(const qvio_user_job& user_job, qvio_user_job_done& user_job_done);
 		void VidUserJob_STOP_STREAMING(const qvio_user_job& user_job, qvio_user_job_done& user_job_done);
 		void VidUserJob_BUF_DONE(const qvio_user_job& user_job, qvio_user_job_done& user_job_done);
+		void VidUserJob_BUF_INIT_BATCH(const qvio_user_job& user_job, qvio_user_job_done& user_job_done);
+		void VidUserJob_BUF_CLEANUP_BATCH(const qvio_user_job& user_job, qvio_user_job_done& user_job_done);
 		void VidUserJob_ERROR(const qvio_user_job& user_job, qvio_user_job_done& user_job_done);
 	};
 
@@ -86,6 +107,9 @@ namespace __04_qviod__ {
 		switch(1) { case 1:
 			nVidFd = -1;
 			nVidUserJobFd = -1;
+			pVidUserJobRings = NULL;
+			nVidUserJobWorkers = (argc > 1) ? atoi(argv[1]) : 0;
+			pszVidDev = (argc > 2) ? argv[2] : "/dev/video0";
 
 			OpenVidRx();
 			VidUserJobHandling();
@@ -109,7 +133,7 @@ namespace __04_qviod__ {
 				break;
 			}
 
-			nVidFd = open("/dev/video0", O_RDWR | O_NONBLOCK);
+			nVidFd = open(pszVidDev, O_RDWR | O_NONBLOCK);
 			if(nVidFd == -1) {
 				err = errno;
 				LOGE("%s(%d): open() failed, err=%d", __FUNCTION__, __LINE__, err);
@@ -128,24 +152,60 @@ namespace __04_qviod__ {
 
 			LOGD("nVidFd=%d", nVidFd);
 
-			err = ioctl(nVidFd, QVID_IOC_USER_JOB_FD, &nVidUserJobFd);
+			// the first user-job fd also gets the session jobs
+			err = OpenVidUserJob(nVidUserJobFd, pVidUserJobRings);
 			if(err) {
-				err = errno;
-				LOGE("%s(%d): ioctl(QVID_IOC_USER_JOB_FD) failed, err=%d", __FUNCTION__, __LINE__, err);
+				LOGE("%s(%d): OpenVidUserJob() failed, err=%d", __FUNCTION__, __LINE__, err);
 				break;
 			}
 			oFreeStack += [&]() {
-				int err;
-
-				err = close(nVidUserJobFd);
-				if(err) {
-					err = errno;
-					LOGE("%s(%d): close() failed, err=%d", __FUNCTION__, __LINE__, err);
-				}
+				CloseVidUserJob(nVidUserJobFd, pVidUserJobRings);
 				nVidUserJobFd = -1;
+				pVidUserJobRings = NULL;
 			};
+		}
+	}
+
+	int App::OpenVidUserJob(int& nFd, qvio_user_job_rings*& pRings) {
+		int err;
+
+		nFd = -1;
+		pRings = NULL;
+
+		err = ioctl(nVidFd, QVID_IOC_USER_JOB_FD, &nFd);
+		if(err) {
+			err = errno;
+			LOGE("%s(%d): ioctl(QVID_IOC_USER_JOB_FD) failed, err=%d", __FUNCTION__, __LINE__, err);
+			return err;
+		}
+
+		LOGD("nFd=%d", nFd);
 
-			LOGD("nVidUserJobFd=%d", nVidUserJobFd);
+#if 1 // USE_USER_JOB_RING
+		void* pMap = mmap(NULL, sizeof(qvio_user_job_rings), PROT_READ | PROT_WRITE, MAP_SHARED, nFd, 0);
+		if(pMap == MAP_FAILED) {
+			err = errno;
+			LOGW("%s(%d): mmap() failed, err=%d, fallback to ioctl", __FUNCTION__, __LINE__, err);
+			return 0;
+		}
+		pRings = (qvio_user_job_rings*)pMap;
+
+		LOGD("pRings=%p", pRings);
+#endif // USE_USER_JOB_RING
+
+		return 0;
+	}
+
+	void App::CloseVidUserJob(int nFd, qvio_user_job_rings* pRings) {
+		int err;
+
+		if(pRings)
+			munmap(pRings, sizeof(qvio_user_job_rings));
+
+		err = close(nFd);
+		if(err) {
+			err = errno;
+			LOGE("%s(%d): close() failed, err=%d", __FUNCTION__, __LINE__, err);
 		}
 	}
 
@@ -163,6 +223,12 @@ namespace __04_qviod__ {
 				break;
 			}
 
+			bVidUserJobQuit = false;
+			bVidUserJobStall = false;
+			for(int i = 0;i < nVidUserJobWorkers;i++) {
+				oVidUserJobWorkers.emplace_back(&App::VidUserJobWorker, this, i);
+			}
+
 			int fd_stdin = 0; // stdin
 
 			while(true) {
@@ -173,7 +239,8 @@ namespace __04_qviod__ {
 				if(fd_stdin > fd_max) fd_max = fd_stdin;
 				if(nVidUserJobFd > fd_max) fd_max = nVidUserJobFd;
 				FD_SET(fd_stdin, &readfds);
-				FD_SET(nVidUserJobFd, &readfds);
+				if(! bVidUserJobStall)
+					FD_SET(nVidUserJobFd, &readfds);
 
 				err = select(fd_max + 1, &readfds, NULL, NULL, NULL);
 				if (err < 0) {
@@ -186,75 +253,265 @@ namespace __04_qviod__ {
 
 					if(ch == 'q')
 						break;
+
+					if(ch == 's' || ch == 'r') {
+						VidUserJobStats(nVidUserJobFd, ch == 'r');
+						VidDeadlineStats();
+					}
+
+					// stall for more than QVIO_USER_JOB_MAX_PENDING frames, streaming must go on
+					if(ch == 'p') {
+						bVidUserJobStall = ! bVidUserJobStall;
+						LOGD("bVidUserJobStall=%d", (int)bVidUserJobStall);
+					}
 				}
 
 				if (FD_ISSET(nVidUserJobFd, &readfds)) {
-					qvio_user_job user_job;
-					qvio_user_job_done user_job_done;
-
-					err = ioctl(nVidUserJobFd, QVID_IOC_USER_JOB_GET, &user_job);
+					err = VidUserJobService(nVidUserJobFd, pVidUserJobRings);
 					if(err) {
-						err = errno;
-						LOGE("%s(%d): ioctl(QVID_IOC_USER_JOB_GET) failed, err=%d", __FUNCTION__, __LINE__, err);
+						LOGE("%s(%d): VidUserJobService() failed, err=%d", __FUNCTION__, __LINE__, err);
 						break;
 					}
+				}
+			}
 
-					switch(user_job.id) {
-					case QVIO_USER_JOB_ID_S_FMT:
-						VidUserJob_S_FMT(user_job, user_job_done);
-						break;
+			bVidUserJobQuit = true;
+			for(auto& oWorker : oVidUserJobWorkers) {
+				oWorker.join();
+			}
+			oVidUserJobWorkers.clear();
 
-					case QVIO_USER_JOB_ID_QUEUE_SETUP:
-						VidUserJob_QUEUE_SETUP(user_job, user_job_done);
-						break;
+			oDeferredTasks.Stop();
+		}
 
-					case QVIO_USER_JOB_ID_BUF_INIT:
-						VidUserJob_BUF_INIT(user_job, user_job_done);
-						break;
+		LOGD("%s(%d):---", __FUNCTION__, __LINE__);
+	}
 
-					case QVIO_USER_JOB_ID_BUF_CLEANUP:
-						VidUserJob_BUF_CLEANUP(user_job, user_job_done);
-						break;
+	void App::VidUserJobWorker(int nWorker) {
+		int err;
+		int nFd;
+		qvio_user_job_rings* pRings;
 
-					case QVIO_USER_JOB_ID_START_STREAMING:
-						VidUserJob_START_STREAMING(user_job, user_job_done);
-						break;
+		LOGD("%s(%d): nWorker=%d +++", __FUNCTION__, __LINE__, nWorker);
 
-					case QVIO_USER_JOB_ID_STOP_STREAMING:
-						VidUserJob_STOP_STREAMING(user_job, user_job_done);
-						break;
+		switch(1) { case 1:
+			err = OpenVidUserJob(nFd, pRings);
+			if(err) {
+				LOGE("%s(%d): OpenVidUserJob() failed, err=%d", __FUNCTION__, __LINE__, err);
+				break;
+			}
 
-					case QVIO_USER_JOB_ID_BUF_DONE:
-						VidUserJob_BUF_DONE(user_job, user_job_done);
-						break;
+			while(! bVidUserJobQuit) {
+				pollfd oPollFd = { nFd, POLLIN, 0 };
 
-					default:
-						VidUserJob_ERROR(user_job, user_job_done);
-						break;
-					}
+				// wake up now and then for bVidUserJobQuit
+				err = poll(&oPollFd, 1, 100);
+				if(err < 0) {
+					err = errno;
+					LOGE("%s(%d): poll() failed, err=%d", __FUNCTION__, __LINE__, err);
+					break;
+				}
+
+				if(err == 0)
+					continue;
+
+				if(bVidUserJobStall) {
+					usleep(100000);
+					continue;
+				}
+
+				err = VidUserJobService(nFd, pRings);
+				if(err) {
+					LOGE("%s(%d): VidUserJobService() failed, err=%d", __FUNCTION__, __LINE__, err);
+					break;
+				}
+			}
+
+			CloseVidUserJob(nFd, pRings);
+		}
 
-					user_job_done.id = user_job.id;
-					user_job_done.sequence = user_job.sequence;
+		LOGD("%s(%d): nWorker=%d ---", __FUNCTION__, __LINE__, nWorker);
+	}
+
+	void App::VidUserJobStats(int nFd, bool bReset) {
+		int err;
+		static const char* pszIds[] = {
+			"S_FMT", "QUEUE_SETUP", "BUF_INIT", "BUF_CLEANUP", "START_STREAMING",
+			"STOP_STREAMING", "BUF_DONE", "BUF_INIT_BATCH", "BUF_CLEANUP_BATCH",
+		};
+
+		std::unique_ptr<qvio_user_job_stats> pStats(new qvio_user_job_stats());
+		pStats->flags = bReset ? QVIO_USER_JOB_STATS_F_RESET : 0;
+
+		err = ioctl(nFd, QVID_IOC_USER_JOB_STATS, pStats.get());
+		if(err) {
+			err = errno;
+			LOGE("%s(%d): ioctl(QVID_IOC_USER_JOB_STATS) failed, err=%d", __FUNCTION__, __LINE__, err);
+			return;
+		}
+
+		auto Avg = [](const qvio_user_job_latency& l) {
+			return l.count ? (unsigned)(l.sum_us / l.count) : 0U;
+		};
+
+		for(int i = 0;i < (int)(sizeof(pszIds) / sizeof(pszIds[0]));i++) {
+			const qvio_user_job_stats_id& s = pStats->id[i];
+
+			if(! s.total.count && ! s.cancelled)
+				continue;
+
+			LOGD("%s: count=%u cancelled=%u, us min/avg/max wait=%u/%u/%u daemon=%u/%u/%u done=%u/%u/%u total=%u/%u/%u",
+				pszIds[i], s.total.count, s.cancelled,
+				s.wait.min_us, Avg(s.wait), s.wait.max_us,
+				s.daemon.min_us, Avg(s.daemon), s.daemon.max_us,
+				s.done.min_us, Avg(s.done), s.done.max_us,
+				s.total.min_us, Avg(s.total), s.total.max_us);
+		}
+	}
+
+	void App::VidDeadlineStats() {
+		int err;
+		qvio_deadline deadline;
+
+		memset(&deadline, 0, sizeof(deadline));
+		err = ioctl(nVidFd, QVID_IOC_G_DEADLINE, &deadline);
+		if(err) {
+			err = errno;
+			LOGE("%s(%d): ioctl(QVID_IOC_G_DEADLINE) failed, err=%d", __FUNCTION__, __LINE__, err);
+			return;
+		}
+
+		LOGD("deadline: fallback=%u interval_us=%u misses=%u", deadline.fallback, deadline.interval_us, deadline.misses);
+	}
+
+	int App::VidUserJobService(int nFd, qvio_user_job_rings* pRings) {
+		int err;
+		qvio_user_job user_job;
+		qvio_user_job_done user_job_done;
+
+		if(pRings)
+			return VidUserJobRingDrain(nFd, pRings);
+
+		err = ioctl(nFd, QVID_IOC_USER_JOB_GET, &user_job);
+		if(err) {
+			err = errno;
+			if(err == EAGAIN)
+				return 0;
+
+			LOGE("%s(%d): ioctl(QVID_IOC_USER_JOB_GET) failed, err=%d", __FUNCTION__, __LINE__, err);
+			return err;
+		}
+
+		VidUserJobDispatch(user_job, user_job_done);
 
 #if 0 // DEBUG
-					LOGD("user_job_done(%d, %d)", (int)user_job_done.id, user_job_done.sequence);
+		LOGD("user_job_done(%d, %d)", (int)user_job_done.id, user_job_done.sequence);
 #endif
 
-#if 1
-					err = ioctl(nVidUserJobFd, QVID_IOC_USER_JOB_DONE, &user_job_done);
-					if(err) {
-						err = errno;
-						LOGE("%s(%d): ioctl(QVID_IOC_USER_JOB_DONE) failed, err=%d", __FUNCTION__, __LINE__, err);
-						break;
-					}
-#endif
+		err = ioctl(nFd, QVID_IOC_USER_JOB_DONE, &user_job_done);
+		if(err) {
+			err = errno;
+			LOGE("%s(%d): ioctl(QVID_IOC_USER_JOB_DONE) failed, err=%d", __FUNCTION__, __LINE__, err);
+			return err;
+		}
+
+		return 0;
+	}
+
+	void App::VidUserJobDispatch(const qvio_user_job& user_job, qvio_user_job_done& user_job_done) {
+		memset(&user_job_done, 0, sizeof(user_job_done));
+
+		switch(user_job.id) {
+		case QVIO_USER_JOB_ID_S_FMT:
+			VidUserJob_S_FMT(user_job, user_job_done);
+			break;
+
+		case QVIO_USER_JOB_ID_QUEUE_SETUP:
+			VidUserJob_QUEUE_SETUP(user_job, user_job_done);
+			break;
+
+		case QVIO_USER_JOB_ID_BUF_INIT:
+			VidUserJob_BUF_INIT(user_job, user_job_done);
+			break;
+
+		case QVIO_USER_JOB_ID_BUF_CLEANUP:
+			VidUserJob_BUF_CLEANUP(user_job, user_job_done);
+			break;
+
+		case QVIO_USER_JOB_ID_START_STREAMING:
+			VidUserJob_START_STREAMING(user_job, user_job_done);
+			break;
+
+		case QVIO_USER_JOB_ID_STOP_STREAMING:
+			VidUserJob_STOP_STREAMING(user_job, user_job_done);
+			break;
+
+		case QVIO_USER_JOB_ID_BUF_DONE:
+			VidUserJob_BUF_DONE(user_job, user_job_done);
+			break;
+
+		case QVIO_USER_JOB_ID_BUF_INIT_BATCH:
+			VidUserJob_BUF_INIT_BATCH(user_job, user_job_done);
+			break;
+
+		case QVIO_USER_JOB_ID_BUF_CLEANUP_BATCH:
+			VidUserJob_BUF_CLEANUP_BATCH(user_job, user_job_done);
+			break;
+
+		default:
+			VidUserJob_ERROR(user_job, user_job_done);
+			break;
+		}
+
+		user_job_done.id = user_job.id;
+		user_job_done.sequence = user_job.sequence;
+	}
+
+	int App::VidUserJobRingDrain(int nFd, qvio_user_job_rings* pRings) {
+		int err;
+		qvio_user_job_ring& job = pRings->job;
+		qvio_user_job_ring& done = pRings->done;
+		bool bDone = false;
+
+		// single consumer of the job ring, single producer of the done ring, one ring pair per fd
+		while(true) {
+			__u32 job_tail = job.tail;
+			if(__atomic_load_n(&job.head, __ATOMIC_ACQUIRE) == job_tail)
+				break;
+
+			const qvio_user_job& user_job = pRings->jobs[job_tail & (QVIO_USER_JOB_RING_SIZE - 1)];
+
+			__u32 done_head = done.head;
+			if(done_head - __atomic_load_n(&done.tail, __ATOMIC_ACQUIRE) >= QVIO_USER_JOB_RING_SIZE) {
+				// nothing posted or polled since, the driver reaps on the kick
+				err = ioctl(nFd, QVID_IOC_USER_JOB_KICK);
+				if(err || done_head - __atomic_load_n(&done.tail, __ATOMIC_ACQUIRE) >= QVIO_USER_JOB_RING_SIZE) {
+					LOGE("%s(%d): done ring is full", __FUNCTION__, __LINE__);
+					return ENOSPC;
 				}
 			}
 
-			oDeferredTasks.Stop();
+			qvio_user_job_done& user_job_done = pRings->dones[done_head & (QVIO_USER_JOB_RING_SIZE - 1)];
+
+			VidUserJobDispatch(user_job, user_job_done);
+
+			__atomic_store_n(&job.tail, job_tail + 1, __ATOMIC_RELEASE);
+			__atomic_store_n(&done.head, done_head + 1, __ATOMIC_RELEASE);
+			bDone = true;
 		}
 
-		LOGD("%s(%d):---", __FUNCTION__, __LINE__);
+		// one kick per drained batch, and only while the driver blocks on a done, poll() reaps the rest
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if(bDone && (__atomic_load_n(&done.flags, __ATOMIC_RELAXED) & QVIO_USER_JOB_RING_F_WAIT)) {
+			err = ioctl(nFd, QVID_IOC_USER_JOB_KICK);
+			if(err) {
+				err = errno;
+				LOGE("%s(%d): ioctl(QVID_IOC_USER_JOB_KICK) failed, err=%d", __FUNCTION__, __LINE__, err);
+				return err;
+			}
+		}
+
+		return 0;
 	}
 
 	void App::VidUserJob_S_FMT(const qvio_user_job& user_job, qvio_user_job_done& user_job_done) {
@@ -296,6 +553,30 @@ namespace __04_qviod__ {
 
 	void App::VidUserJob_BUF_DONE(const qvio_user_job& user_job, qvio_user_job_done& user_job_done) {
 		LOGD("%s(%d): index=%d", __FUNCTION__, (int)user_job.sequence, user_job.u.buf_done.index);
+
+		// output, the application's frame is ready to be consumed, answering returns it to the application
+		if(V4L2_TYPE_IS_OUTPUT(oVidDstFormat.type)) {
+			LOGD("bytesused=%u,%u timestamp=%u.%09u", user_job.u.buf_done.bytesused[0], user_job.u.buf_done.bytesused[1],
+				user_job.u.buf_done.timestamp_sec, user_job.u.buf_done.timestamp_nsec);
+		}
+	}
+
+	void App::VidUserJob_BUF_INIT_BATCH(const qvio_user_job& user_job, qvio_user_job_done& user_job_done) {
+		LOGD("%s(%d): count=%d num_planes=%d", __FUNCTION__, (int)user_job.sequence,
+			(int)user_job.u.buf_init_batch.count, (int)user_job.u.buf_init_batch.num_planes);
+
+		// all buffers of the batch are registered at once, one answer for all
+		for(unsigned int i = 0;i < user_job.u.buf_init_batch.count;i++) {
+			LOGD("index=%d offset=0x%X length=%d", user_job.u.buf_init_batch.bufs[i].index,
+				user_job.u.buf_init_batch.bufs[i].offset[0], (int)user_job.u.buf_init_batch.bufs[i].length[0]);
+
+			// -1 keeps the driver's vmalloc buffer, a dma-buf fd here (e.g. from qdmabuf) becomes its mmap backing
+			user_job_done.u.buf_init_batch.dma_buf[i] = -1;
+		}
+	}
+
+	void App::VidUserJob_BUF_CLEANUP_BATCH(const qvio_user_job& user_job, qvio_user_job_done& user_job_done) {
+		LOGD("%s(%d): count=%d", __FUNCTION__, (int)user_job.sequence, (int)user_job.u.buf_cleanup_batch.count);
 	}
 
 	void App::VidUserJob_ERROR(const qvio_user_job& user_job, qvio_user_job_done& user_job_done) {
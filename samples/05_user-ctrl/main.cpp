@@ -14,6 +14,8 @@
 #include <sys/mman.h>
 #include <linux/videodev2.h>
 #include <linux/media.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
 #include <linux/version.h>
 
 #include <vector>
@@ -227,17 +229,20 @@ namespace __05_user_ctrl__ {
 		int nFd;
 		int nMmapSize;
 		void* pMmap;
+		int nI2cFd; // qvio-i2c adapter through i2c-dev, the FIFO is driven from userspace otherwise
 		ZzUtils::FreeStack oFreeStack;
 
 		explicit UserCtrl();
 		~UserCtrl();
 
 		int Open(const char* fn);
+		int OpenI2c(const char* fn);
 		void Close();
 
 		uint32_t ReadRegister(int nOffset);
 		void WriteRegister(int nOffset, uint32_t nValue);
 		bool AccessI2cRegisterS(uint8_t bDevAddr, uint8_t* pTxBuf, uint32_t nTxLen, uint8_t* pRxBuf, uint32_t nRxLen, uint32_t DELAY_100US);
+		bool AccessI2cDevS(uint8_t bDevAddr, uint8_t* pTxBuf, uint32_t nTxLen, uint8_t* pRxBuf, uint32_t nRxLen);
 		bool AccessSlaveDeviceRegisterS(uint8_t bDevAddr, uint8_t* pTxBuf, uint32_t nTxLen, uint8_t* pRxBuf, uint32_t nRxLen);
 		bool AccessMcuRegisterS(uint8_t bDevAddr, uint8_t* pTxBuf, uint32_t nTxLen, uint8_t* pRxBuf, uint32_t nRxLen);
 	};
@@ -262,12 +267,14 @@ namespace __05_user_ctrl__ {
 		void UserCtrl5();
 		void UserCtrl6();
 		void UserCtrl7();
+		void UserCtrl8();
 	};
 
 	UserCtrl::UserCtrl() {
 		nFd = -1;
 		nMmapSize = 0xFFFF;
 		pMmap = MAP_FAILED;
+		nI2cFd = -1;
 	}
 
 	UserCtrl::~UserCtrl() {
@@ -317,6 +324,33 @@ namespace __05_user_ctrl__ {
 		return err;
 	}
 
+	int UserCtrl::OpenI2c(const char* fn) {
+		int err = 0;
+
+		switch(1) { case 1:
+			nI2cFd = open(fn, O_RDWR);
+			if(nI2cFd == -1) {
+				err = errno;
+				LOGE("%s(%d): open() failed, err=%d", __FUNCTION__, __LINE__, err);
+				break;
+			}
+			oFreeStack += [&]() {
+				int err;
+
+				err = close(nI2cFd);
+				if(err) {
+					err = errno;
+					LOGE("%s(%d): close() failed, err=%d", __FUNCTION__, __LINE__, err);
+				}
+				nI2cFd = -1;
+			};
+
+			LOGD("nI2cFd=%d", nI2cFd);
+		}
+
+		return err;
+	}
+
 	void UserCtrl::Close() {
 		oFreeStack.Flush();
 	}
@@ -329,8 +363,44 @@ namespace __05_user_ctrl__ {
 		*(uint32_t*)((uint8_t*)pMmap + nOffset) = nValue;
 	}
 
+	bool UserCtrl::AccessI2cDevS(uint8_t bDevAddr, uint8_t* pTxBuf, uint32_t nTxLen, uint8_t* pRxBuf, uint32_t nRxLen) {
+		int err;
+		struct i2c_msg msgs[2];
+		struct i2c_rdwr_ioctl_data rdwr;
+
+		// one transfer, repeated start between the write and the read
+		rdwr.msgs = msgs;
+		rdwr.nmsgs = 0;
+		if(nTxLen > 0) {
+			msgs[rdwr.nmsgs].addr = bDevAddr >> 1;
+			msgs[rdwr.nmsgs].flags = 0;
+			msgs[rdwr.nmsgs].len = nTxLen;
+			msgs[rdwr.nmsgs].buf = pTxBuf;
+			rdwr.nmsgs++;
+		}
+		if(nRxLen > 0) {
+			msgs[rdwr.nmsgs].addr = bDevAddr >> 1;
+			msgs[rdwr.nmsgs].flags = I2C_M_RD;
+			msgs[rdwr.nmsgs].len = nRxLen;
+			msgs[rdwr.nmsgs].buf = pRxBuf;
+			rdwr.nmsgs++;
+		}
+
+		err = ioctl(nI2cFd, I2C_RDWR, &rdwr);
+		if(err == -1) {
+			err = errno;
+			LOGE("%s(%d): ioctl(I2C_RDWR) failed, err=%d", __FUNCTION__, __LINE__, err);
+			return false;
+		}
+
+		return true;
+	}
+
 	bool UserCtrl::AccessI2cRegisterS(uint8_t bDevAddr, uint8_t* pTxBuf, uint32_t nTxLen, uint8_t* pRxBuf, uint32_t nRxLen, uint32_t DELAY_100US)
 	{
+		if(nI2cFd != -1)
+			return AccessI2cDevS(bDevAddr, pTxBuf, nTxLen, pRxBuf, nRxLen);
+
 		bool is_success = false;
 
 		uint32_t i = 0;
@@ -612,6 +682,10 @@ namespace __05_user_ctrl__ {
 				case '7':
 					UserCtrl7();
 					break;
+
+				case '8':
+					UserCtrl8();
+					break;
 				}
 
 				return err;
@@ -640,6 +714,15 @@ namespace __05_user_ctrl__ {
 			oFreeStack += [&]() {
 				oUserCtrl.Close();
 			};
+
+			// e.g. /dev/i2c-5, the "qvio-i2c" adapter listed by i2cdetect -l
+			if(argc > 1) {
+				err = oUserCtrl.OpenI2c(argv[1]);
+				if(err) {
+					LOGE("%s(%d): oUserCtrl.OpenI2c() failed, err=%d", __FUNCTION__, __LINE__, err);
+					break;
+				}
+			}
 		}
 	}
 
@@ -716,6 +799,46 @@ namespace __05_user_ctrl__ {
 		oUserCtrl.WriteRegister(0x000000D0, R000000D0);
 		LOGD("R000000D0=%d(0x%X)", R000000D0, R000000D0);
 	}
+
+	// the driver's cached copy of UserCtrl3's table, no I2C traffic
+	void App::UserCtrl8() {
+		int err;
+		int nFd;
+		qvio_mcu_table oMcuTable;
+
+		switch(1) { case 1:
+			nFd = open("/dev/video0", O_RDWR | O_NONBLOCK);
+			if(nFd == -1) {
+				err = errno;
+				LOGE("%s(%d): open() failed, err=%d", __FUNCTION__, __LINE__, err);
+				break;
+			}
+
+			memset(&oMcuTable, 0, sizeof(oMcuTable));
+			err = ioctl(nFd, QVID_IOC_G_MCU_TABLE, &oMcuTable);
+			if(err) {
+				err = errno;
+				LOGE("%s(%d): ioctl(QVID_IOC_G_MCU_TABLE) failed, err=%d", __FUNCTION__, __LINE__, err);
+				close(nFd);
+				break;
+			}
+			close(nFd);
+
+			static_assert(sizeof(MCU_RESOLUCTION) == QVIO_MCU_ENTRY_SIZE, "MCU_RESOLUCTION");
+			MCU_RESOLUCTION& reso = *(MCU_RESOLUCTION*)oMcuTable.entry;
+			LOGD("sequence=%u reso={%d,%d,%d,%d,%d,%d} hdr={%02X,%02X,%02X}",
+				oMcuTable.sequence,
+				(int)reso.vtotal,
+				(int)reso.htotal,
+				(int)reso.vactive,
+				(int)reso.hactive,
+				(int)reso.fps,
+				(int)reso.modeflag,
+				(int)reso.hdrpacket.HPB0[0],
+				(int)reso.hdrpacket.HPB0[1],
+				(int)reso.hdrpacket.HPB0[2]);
+		}
+	}
 }
 
 using namespace __05_user_ctrl__;
@@ -12,8 +12,13 @@ enum qvio_user_job_id {
 	QVIO_USER_JOB_ID_START_STREAMING,
 	QVIO_USER_JOB_ID_STOP_STREAMING,
 	QVIO_USER_JOB_ID_BUF_DONE,
+	QVIO_USER_JOB_ID_BUF_INIT_BATCH,
+	QVIO_USER_JOB_ID_BUF_CLEANUP_BATCH,
 };
 
+#define QVIO_USER_JOB_MAX_BATCH		32 // buffers per batch job, VB2_MAX_FRAME
+#define QVIO_USER_JOB_MAX_PLANES	2
+
 struct qvio_user_job {
 	__u16 id;
 	__u16 sequence;
@@ -45,7 +50,26 @@ struct qvio_user_job {
 
 		struct {
 			int index;
+			// output nodes only, what the application queued
+			unsigned int bytesused[QVIO_USER_JOB_MAX_PLANES];
+			__u32 timestamp_sec;
+			__u32 timestamp_nsec;
 		} buf_done;
+
+		struct {
+			unsigned int count;
+			unsigned int num_planes;
+			struct {
+				int index;
+				unsigned int offset[QVIO_USER_JOB_MAX_PLANES];	// mmap offset on the video node
+				unsigned int length[QVIO_USER_JOB_MAX_PLANES];
+			} bufs[QVIO_USER_JOB_MAX_BATCH];
+		} buf_init_batch;
+
+		struct {
+			unsigned int count;
+			int index[QVIO_USER_JOB_MAX_BATCH];
+		} buf_cleanup_batch;
 	} u;
 };
 
@@ -83,23 +107,217 @@ struct qvio_user_job_done {
 		} stop_streaming;
 
 		struct {
-			int flags;
+			int flags;	// < 0: the buffer is returned with V4L2_BUF_FLAG_ERROR
 		} buf_done;
+
+		struct {
+			int flags;
+			int dma_buf[QVIO_USER_JOB_MAX_BATCH];	// in job order
+			int offset[4];	// layout shared by all buffers of the batch
+			int pitch[4];
+			int psize[4];
+		} buf_init_batch;
+
+		struct {
+			int flags;
+		} buf_cleanup_batch;
 	} u;
 };
 
+// user-job rings, mmap'ed from the user-job fd at offset 0
+#define QVIO_USER_JOB_RING_SIZE		64 // entries, power of 2
+#define QVIO_USER_JOB_RING_F_WAIT	0x1 // done ring, the driver blocks on a done, the daemon must kick
+
+struct qvio_user_job_ring {
+	__u32 head;			// free running, written by the producer
+	__u32 tail;			// free running, written by the consumer
+	__u32 flags;		// QVIO_USER_JOB_RING_F_*, written by the driver
+	__u32 reserved[13];	// one cache line per ring header
+};
+
+struct qvio_user_job_rings {
+	// driver -> daemon, poll() the fd for EPOLLIN when empty
+	struct qvio_user_job_ring job;
+	struct qvio_user_job jobs[QVIO_USER_JOB_RING_SIZE];
+
+	// daemon -> driver, reaped on each BUF_DONE post, frame interval and poll(),
+	// QVID_IOC_USER_JOB_KICK only if F_WAIT is set
+	struct qvio_user_job_ring done;
+	struct qvio_user_job_done dones[QVIO_USER_JOB_RING_SIZE];
+};
+
+// user-job latency statistics, per job id and per node
+#define QVIO_USER_JOB_STATS_IDS		16 // qvio_user_job_id, room for ids to come
+#define QVIO_USER_JOB_STATS_BUCKETS	16 // bucket i counts [2^i, 2^(i+1)) us, 0 from 0 and the last is open ended
+#define QVIO_USER_JOB_STATS_F_RESET	0x1 // zero the statistics after reading them
+
+struct qvio_user_job_latency {
+	__u32 count;
+	__u32 min_us;
+	__u32 max_us;
+	__u32 reserved;
+	__u64 sum_us;		// avg is sum_us / count
+	__u32 hist[QVIO_USER_JOB_STATS_BUCKETS];
+};
+
+struct qvio_user_job_stats_id {
+	struct qvio_user_job_latency wait;		// post to GET, jobs taken with QVID_IOC_USER_JOB_GET only
+	struct qvio_user_job_latency daemon;	// GET to DONE, jobs taken with QVID_IOC_USER_JOB_GET only
+	struct qvio_user_job_latency done;		// DONE to the driver being through with it
+	struct qvio_user_job_latency total;		// post to the driver being through with it
+	__u32 cancelled;
+	__u32 reserved[3];
+};
+
+struct qvio_user_job_stats {
+	__u32 flags;		// QVIO_USER_JOB_STATS_F_*
+	__u32 reserved[3];
+	struct qvio_user_job_stats_id id[QVIO_USER_JOB_STATS_IDS];
+};
+
+// qvio pixel formats
+#ifndef V4L2_PIX_FMT_P010
+#define V4L2_PIX_FMT_P010		v4l2_fourcc('P', '0', '1', '0') // Y/CbCr 4:2:0, 10 bits msb aligned in 16
+#endif
+#define QVIO_PIX_FMT_V210		v4l2_fourcc('v', '2', '1', '0') // YUV 4:2:2 10-bit packed, 6 pixels in 16 bytes
+
+// qvio v4l2 events
+#define QVIO_EVENT_SLICE		(V4L2_EVENT_PRIVATE_START + 1)
+#define QVIO_EVENT_MCU_TABLE	(V4L2_EVENT_PRIVATE_START + 2) // the cached MCU table changed, no payload
+
+struct qvio_event_slice {
+	__u32 index;		// vb2 buffer index
+	__u32 sequence;		// frame sequence the buffer will complete with
+	__u32 slice;		// completed slice, 0 ~ slices-1
+	__u32 slices;		// number of slices of this buffer
+	__u32 bytesused;	// bytes valid from the start of the buffer
+	__u32 rows;			// bytesused in bytesperline units
+};
+
+// user-job deadline fallback, a frame the daemon misses is completed by the driver
+#define QVIO_DEADLINE_OFF		0
+#define QVIO_DEADLINE_REPEAT	1 // repeat the last good frame
+#define QVIO_DEADLINE_SLATE		2 // black slate
+
+struct qvio_deadline {
+	__u32 fallback;		// QVIO_DEADLINE_*, applied at the next STREAMON
+	__u32 interval_us;	// read-only, the frame interval the deadline runs at
+	__u32 misses;		// read-only, frames completed by the driver since STREAMON
+	__u32 reserved[5];
+};
+
+// frame clock of user-job capture nodes, at the VIDIOC_S_PARM interval
+struct qvio_frame_clock {
+	__u32 enable;			// applied at the next STREAMON
+	__u32 interval_ns;		// read-only, whole nanoseconds, the remainder is carried
+	__u64 ticks;			// read-only, frame boundaries since STREAMON
+	__u32 frames;			// read-only, buffers completed on a boundary
+	__u32 underruns;		// read-only, boundaries the daemon had nothing ready for
+	__u32 overruns;			// read-only, boundaries skipped, the timer fired too late
+	__u32 jitter_avg_ns;	// read-only, boundary to buffer completion
+	__u32 jitter_max_ns;
+	__s32 drift_ns;			// read-only, the last completion against the ideal clock from STREAMON
+	__u32 reserved[6];
+};
+
+// transfer-timeout watchdog of capture nodes, an overdue transfer resets the channel's engine
+struct qvio_watchdog {
+	__u32 frames;		// frame intervals a transfer may take, 0 - off, applied at the next STREAMON
+	__u32 timeout_us;	// read-only, the timeout the watchdog runs at
+	__u32 recoveries;	// read-only, engine resets that succeeded since STREAMON, their buffers return with V4L2_BUF_FLAG_ERROR
+	__u32 failures;		// read-only, engine resets that failed since STREAMON
+	__u64 last_ns;		// read-only, CLOCK_MONOTONIC of the last engine reset
+	__u32 reserved[4];
+};
+
+// vectored BAR register access on the qvio cdev, entries run in order in one call
+#define QVIO_REG_OP_READ		0 // value = reg
+#define QVIO_REG_OP_WRITE		1 // reg = value
+#define QVIO_REG_OP_RMW			2 // reg = (reg & ~mask) | (value & mask), value = the new reg
+#define QVIO_REG_OP_POLL		3 // until (reg & mask) == (value & mask) or timeout_us, value = the last reg
+#define QVIO_REG_OPS_MAX		1024 // entries per call
+#define QVIO_REG_OPS_F_UNCACHED	0x1 // drop the driver's register shadow first, reads hit the card
+
+struct qvio_reg_op {
+	__u32 offset;		// bytes from the start of the user BAR, 32-bit aligned
+	__u32 value;
+	__u32 op;			// QVIO_REG_OP_*
+	__u32 mask;
+};
+
+struct qvio_reg_ops {
+	__u64 ops;			// struct qvio_reg_op array, values are written back
+	__u32 count;
+	__u32 timeout_us;	// per QVIO_REG_OP_POLL entry
+	__u32 done;			// entries completed, the failed entry on error
+	__u32 flags;		// QVIO_REG_OPS_F_*
+	__u32 reserved[2];
+};
+
+// card user interrupts on the qvio cdev, poll() for EPOLLIN while any delivered line is pending
+#define QVIO_USER_IRQ_MAX		16
+
+struct qvio_user_irq_events {
+	__u32 pending;		// delivered lines raised since the last call, cleared by it
+	__u32 mask;			// delivered lines
+	__u32 count[QVIO_USER_IRQ_MAX];	// free running, every line, delivered or not
+};
+
+struct qvio_user_irq_eventfd {
+	__u32 line;
+	__s32 fd;			// signaled for each delivered interrupt of the line, -1 to detach
+};
+
+// MCU parameter table of a capture node, as cached by the driver
+#define QVIO_MCU_HEADER_SIZE	4 // HDMI20_INTERFACE up to resolution[], selport, data_port_num, bitrate
+#define QVIO_MCU_ENTRY_SIZE		60 // MCU_RESOLUCTION of the node's channel
+
+// offsets in qvio_mcu_table.entry
+#define QVIO_MCU_ENTRY_TIMING		0 // vtotal, htotal, vactive, hactive, fps, modeflag
+#define QVIO_MCU_ENTRY_VIDEOSOURCE	14
+#define QVIO_MCU_ENTRY_HDRPACKET	22 // 30 bytes
+#define QVIO_MCU_ENTRY_PTZ_OTHER	52 // 8 bytes
+
+#define QVIO_MCU_TABLE_F_REFRESH	0x1 // read the MCU now instead of returning the cache
+
+struct qvio_mcu_table {
+	__u32 flags;		// QVIO_MCU_TABLE_F_*
+	__u32 sequence;		// read-only, bumped each time the table changed
+	__u64 timestamp_ns;	// read-only, CLOCK_MONOTONIC of the last MCU read
+	__u8 header[QVIO_MCU_HEADER_SIZE];
+	__u8 entry[QVIO_MCU_ENTRY_SIZE];
+	__u32 reserved[4];
+};
+
 #define QVID_IOC_MAGIC		'Q'
 
 // qvio cdev ioctls
 #define QVID_IOC_IOCOFFLINE		_IO  (QVID_IOC_MAGIC, 1)
 #define QVID_IOC_IOCONLINE		_IO  (QVID_IOC_MAGIC, 2)
+#define QVID_IOC_REG_OPS		_IOWR(QVID_IOC_MAGIC, 3, struct qvio_reg_ops)
+#define QVID_IOC_USER_IRQ_GET		_IOR (QVID_IOC_MAGIC, 4, struct qvio_user_irq_events)
+#define QVID_IOC_USER_IRQ_S_MASK	_IOW (QVID_IOC_MAGIC, 5, __u32) // lines delivered, none at probe
+#define QVID_IOC_USER_IRQ_EVENTFD	_IOW (QVID_IOC_MAGIC, 6, struct qvio_user_irq_eventfd)
+#define QVID_IOC_ENGINE_OFFLINE		_IOW (QVID_IOC_MAGIC, 7, __u32) // C2H channel, in-flight buffers return as errors
+#define QVID_IOC_ENGINE_ONLINE		_IOW (QVID_IOC_MAGIC, 8, __u32) // C2H channel, buffers held while offline are submitted
+#define QVID_IOC_ENGINE_RESET		_IOW (QVID_IOC_MAGIC, 9, __u32) // C2H channel, offline then online
 
 // qvio v4l2 ioctls
-#define QVID_IOC_USER_JOB_FD	_IOR (QVID_IOC_MAGIC, BASE_VIDIOC_PRIVATE+0, int)
+#define QVID_IOC_USER_JOB_FD	_IOR (QVID_IOC_MAGIC, BASE_VIDIOC_PRIVATE+0, int) // a new fd per call, one per daemon worker
 #define QVID_IOC_BUF_DONE		_IO  (QVID_IOC_MAGIC, BASE_VIDIOC_PRIVATE+1)
+#define QVID_IOC_S_GROUP		_IOW (QVID_IOC_MAGIC, BASE_VIDIOC_PRIVATE+2, int) // 1: join the card's capture group, 0: leave
+#define QVID_IOC_G_DEADLINE		_IOR (QVID_IOC_MAGIC, BASE_VIDIOC_PRIVATE+3, struct qvio_deadline)
+#define QVID_IOC_S_DEADLINE		_IOW (QVID_IOC_MAGIC, BASE_VIDIOC_PRIVATE+4, struct qvio_deadline)
+#define QVID_IOC_G_FRAME_CLOCK	_IOR (QVID_IOC_MAGIC, BASE_VIDIOC_PRIVATE+5, struct qvio_frame_clock)
+#define QVID_IOC_S_FRAME_CLOCK	_IOW (QVID_IOC_MAGIC, BASE_VIDIOC_PRIVATE+6, struct qvio_frame_clock)
+#define QVID_IOC_G_MCU_TABLE	_IOWR(QVID_IOC_MAGIC, BASE_VIDIOC_PRIVATE+7, struct qvio_mcu_table)
+#define QVID_IOC_G_WATCHDOG		_IOR (QVID_IOC_MAGIC, BASE_VIDIOC_PRIVATE+8, struct qvio_watchdog)
+#define QVID_IOC_S_WATCHDOG		_IOW (QVID_IOC_MAGIC, BASE_VIDIOC_PRIVATE+9, struct qvio_watchdog)
 
 // USER_JOB_FD ioctls
 #define QVID_IOC_USER_JOB_GET	_IOR (QVID_IOC_MAGIC, 1, struct qvio_user_job)
 #define QVID_IOC_USER_JOB_DONE	_IOW (QVID_IOC_MAGIC, 2, struct qvio_user_job_done)
+#define QVID_IOC_USER_JOB_KICK	_IO  (QVID_IOC_MAGIC, 3)
+#define QVID_IOC_USER_JOB_STATS	_IOWR(QVID_IOC_MAGIC, 4, struct qvio_user_job_stats)
 
 #endif /* _UAPI_LINUX_QVIO_H */